@@ -889,55 +889,55 @@ end
 
 toc.opschema.SUM = schema ""
 function toc.opcodes.SUM(emit, state, op)
-   emit:stmt("return pdcrt_op_sum(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_sum(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.MUL = schema ""
 function toc.opcodes.MUL(emit, state, op)
-   emit:stmt("return pdcrt_op_mul(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_mul(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.SUB = schema ""
 function toc.opcodes.SUB(emit, state, op)
-   emit:stmt("return pdcrt_op_sub(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_sub(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.DIV = schema ""
 function toc.opcodes.DIV(emit, state, op)
-   emit:stmt("return pdcrt_op_div(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_div(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.GT = schema ""
 function toc.opcodes.GT(emit, state, op)
-   emit:stmt("return pdcrt_op_gt(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_gt(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.LT = schema ""
 function toc.opcodes.LT(emit, state, op)
-   emit:stmt("return pdcrt_op_lt(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_lt(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.GE = schema ""
 function toc.opcodes.GE(emit, state, op)
-   emit:stmt("return pdcrt_op_ge(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_ge(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.LE = schema ""
 function toc.opcodes.LE(emit, state, op)
-   emit:stmt("return pdcrt_op_le(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_le(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.OPEQ = schema ""
 function toc.opcodes.OPEQ(emit, state, op)
-   emit:stmt("return pdcrt_op_opeq(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_opeq(marco, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
@@ -996,14 +996,26 @@ function toc.opcodes.MKARR(emit, state, op)
    emit:stmt("pdcrt_op_mkarr(marco, «1:int»)", op.Ua)
 end
 
+-- Salta a la parte `ccid` del procedimiento actual. Los saltos hacia atrás
+-- (a la parte actual o a una anterior) pueden formar bucles, así que usan
+-- `PDCRT_LOOP` para que el recolector de basura pueda ejecutarse.
+local function emitjump(emit, state, ccid)
+   local current_ccid = state.next_ccid - 1
+   if ccid <= current_ccid then
+      emit:stmt("PDCRT_LOOP(«1:contproc», «2:contname»)", state.current_proc.id, ccid)
+   else
+      emit:stmt("PDCRT_JUMP(«1:contproc», «2:contname»)", state.current_proc.id, ccid)
+   end
+end
+
 toc.opschema.CHOOSE = schema "Tx, Ty"
 function toc.opcodes.CHOOSE(emit, state, op)
    local cont_consq = state.labels_to_ccid[op.Tx]
    local cont_alt = state.labels_to_ccid[op.Ty]
    emit:toplevelstmt("if(pdcrt_op_choose(marco)) {")
-   emit:stmt("PDCRT_CONTINUE(«1:contproc», «2:contname»)", state.current_proc.id, cont_consq)
+   emitjump(emit, state, cont_consq)
    emit:toplevelstmt("} else {")
-   emit:stmt("PDCRT_CONTINUE(«1:contproc», «2:contname»)", state.current_proc.id, cont_alt)
+   emitjump(emit, state, cont_alt)
    emit:toplevelstmt("}")
 end
 
@@ -1014,8 +1026,7 @@ end
 
 toc.opschema.JMP = schema "Tx"
 function toc.opcodes.JMP(emit, state, op)
-   emit:stmt("PDCRT_CONTINUE(«1:contproc», «2:contname»)",
-             state.current_proc.id, state.labels_to_ccid[op.Tx])
+   emitjump(emit, state, state.labels_to_ccid[op.Tx])
 end
 
 toc.opschema.ROT = schema "Ia"
@@ -1045,19 +1056,19 @@ end
 
 toc.opschema.CMPEQ = schema ""
 function toc.opcodes.CMPEQ(emit, state, op)
-   emit:stmt("return pdcrt_op_cmp(marco, PDCRT_CMP_EQ, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_cmp(marco, PDCRT_CMP_EQ, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.CMPNEQ = schema ""
 function toc.opcodes.CMPNEQ(emit, state, op)
-   emit:stmt("return pdcrt_op_cmp(marco, PDCRT_CMP_NEQ, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_cmp(marco, PDCRT_CMP_NEQ, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
 toc.opschema.CMPREFEQ = schema ""
 function toc.opcodes.CMPREFEQ(emit, state, op)
-   emit:stmt("return pdcrt_op_cmp(marco, PDCRT_CMP_REFEQ, &PDCRT_CONT_NAME(«1:contproc», «2:contname»))",
+   emit:stmt("PDCRT_FUSE(«1:contproc», «2:contname», pdcrt_op_cmp(marco, PDCRT_CMP_REFEQ, &PDCRT_CONT_NAME(«1:contproc», «2:contname»)))",
              state.current_proc.id, state.next_ccid)
 end
 
@@ -1086,7 +1097,60 @@ local function MSG_function(is_tail, is_variadic, is_dyn)
    return func
 end
 
+-- Saca los parámetros de `proc` de la pila y los guarda en sus locales.
+local function emitparams(emit, proc)
+   for i = #proc.params, 1, -1 do
+      local p = proc.params[i]
+      emit:stmt("PDCRT_PARAM(«1:localid», «1:localname»)", p[2])
+   end
+end
+
+-- Determina si `proc` podría llamarse a sí mismo con un envío "tail". Estos
+-- procedimientos tienen una continuación extra (la `k1`) para que
+-- `PDCRT_LOOP` pueda volver al trampolín al saltar a su principio.
+function toc.hasselftail(proc)
+   if proc.method or proc.variadic then
+      -- Los métodos y procedimientos variadicos reciben sus argumentos de
+      -- otra forma.
+      return false
+   end
+   for i = 1, #proc.parts do
+      local kreq = proc.parts[i].kreq
+      if kreq and (kreq[1] == "TMSG" or kreq[1] == "TDYNMSG") then
+         return true
+      end
+   end
+   return false
+end
+
+-- Un envío "tail" de `llamar` a una closure del procedimiento actual es un
+-- bucle. En vez de volver al trampolín (que destruiría el marco y volvería a
+-- crearlo) se reinicia el marco actual y se salta al principio del
+-- procedimiento. Como no se sabe en tiempo de compilación a qué closure se le
+-- envía el mensaje, el runtime lo comprueba y, si no es una llamada propia, se
+-- hace el envío normal.
+local function emitselftail(emit, state, op, is_dyn)
+   local proc = state.current_proc
+   if not toc.hasselftail(proc) then
+      return
+   end
+   if is_dyn then
+      emit:toplevelstmt("if(pdcrt_op_tail_dynmsg_propio(marco, «1:procname», «2:int», «3:int», «4:int»)) {",
+                        proc.id, op.Uargs, op.Urets, #proc.params)
+   else
+      emit:toplevelstmt("if(pdcrt_op_tail_msg_propio(marco, «1:procname», «2:int», «3:int», «4:int», «5:int»)) {",
+                        proc.id, op.Cmsg, op.Uargs, op.Urets, #proc.params)
+   end
+   emitparams(emit, proc)
+   emit:stmt("PDCRT_LOOP(«1:contproc», «2:contname»)", proc.id, 1)
+   emit:toplevelstmt("}")
+end
+
 local function MSG_opcode(emit, state, op, is_tail, is_variadic, is_dyn)
+   if is_tail and not is_variadic then
+      emitselftail(emit, state, op, is_dyn)
+   end
+
    local func = MSG_function(is_tail, is_variadic, is_dyn)
    local args = {}
    local fmt = {}
@@ -1097,6 +1161,16 @@ local function MSG_opcode(emit, state, op, is_tail, is_variadic, is_dyn)
       fmt[#fmt + 1] = ("&PDCRT_CONT_NAME(«%d:contproc», «%d:contname»)"):format(#args - 1, #args)
    end
 
+   if not is_variadic then
+      -- Cada sitio de envío tiene su propia caché.
+      local cacheid = ("cache_%d_%d"):format(state.srcloc.lineno, state.srcloc.colno)
+      local sitio = ("%d:%d"):format(state.srcloc.lineno, state.srcloc.colno)
+      emit:stmt("static pdcrt_cache_de_mensaje «1:cid» = { .sitio = «2:strlit» }", cacheid, sitio)
+      func = func .. "_cache"
+      args[#args + 1] = cacheid
+      fmt[#fmt + 1] = ("&«%d:cid»"):format(#args)
+   end
+
    if not is_dyn then
       local msg = state.constants[op.Cmsg]
       assert(msg.type == "string")
@@ -1165,12 +1239,12 @@ function toc.opcodes.TMSGV(emit, state, op)
 end
 
 toc.opschema.TDYNMSG = schema "Uargs, Urets"
-function toc.opcodes.DYNMSG(emit, state, op)
+function toc.opcodes.TDYNMSG(emit, state, op)
    MSG_helper(emit, state, op)
 end
 
 toc.opschema.TDYNMSGV = schema "Cproto, Urets"
-function toc.opcodes.DYNMSGV(emit, state, op)
+function toc.opcodes.TDYNMSGV(emit, state, op)
    MSG_helper(emit, state, op)
 end
 
@@ -1386,24 +1460,15 @@ function toc.compparts(emit, state, proc)
    if proc.variadic then
       emit:stmt("PDCRT_PROC_VARIADIC(«1:localname», «2:int», «3:localid»)", proc.id, #proc.params, proc.variadic)
    end
-   for i = #proc.params, 1, -1 do
-      local p = proc.params[i]
-      emit:stmt("PDCRT_PARAM(«1:localid», «1:localname»)", p[2])
-   end
+   emitparams(emit, proc)
    if proc.pragmas.FRAME_NAME then
       assert(type(proc.pragmas.FRAME_NAME) == "string", "`PRAGMA FRAME_NAME` needs a string argument.")
       emit:stmt("PDCRT_FRAME_NAME(«1:strlit»)", proc.pragmas.FRAME_NAME)
    end
    if #proc.parts > 0 then
-      log.dbg("emitting main part for procedure %s", proc.id)
-      toc.comppart(emit, substate, proc.parts[1], 2)
-      log.dbg("emitted")
+      emit:stmt("PDCRT_ENTER_BODY(«1:contproc», «2:int»)", proc.id, 1)
    else
       warnabout("empty_function", "procedure %s is empty", proc.id)
-   end
-   if #proc.parts > 1 and contains(FALLS_THROUGHT, proc.parts[1].kreq[1]) then
-      emit:stmt("PDCRT_CONTINUE(«1:contproc», «2:contname»)", proc.id, 2)
-   else
       emit:stmt("PDCRT_RETURN(0)")
    end
    emit:closetoplevel("}")
@@ -1412,22 +1477,39 @@ function toc.compparts(emit, state, proc)
       log.dbg("procedure %s has #%d continuations", proc.id, #proc.parts - 1)
    end
 
-   for i = 2, #proc.parts do
-      local part = proc.parts[i]
-      log.dbg("compiling continuation #%d (%d)", i - 1, i)
+   local firstcont = toc.hasselftail(proc) and 1 or 2
+   for i = firstcont, #proc.parts do
       emit:opentoplevel("PDCRT_CONT(«1:contproc», «2:contname») {", proc.id, i)
       emit:stmt("PDCRT_CONT_PRELUDE(«1:contproc», «2:contname»)", proc.id, i)
+      emit:stmt("PDCRT_ENTER_BODY(«1:contproc», «2:int»)", proc.id, i)
+      emit:closetoplevel("}")
+   end
+
+   if #proc.parts == 0 then
+      return
+   end
+
+   -- Todas las partes se emiten en orden dentro del cuerpo, así que una parte
+   -- que termina en `NAME` simplemente continúa con la siguiente.
+   log.dbg("emitting body for procedure %s", proc.id)
+   emit:opentoplevel("PDCRT_BODY(«1:contproc») {", proc.id)
+   emit:toplevelstmt("PDCRT_BODY_PRELUDE(«1:contproc») {", proc.id)
+   for i = 1, #proc.parts do
+      emit:stmt("PDCRT_BODY_ENTRY(«1:contproc», «2:contname», «3:int»)", proc.id, i, i)
+   end
+   emit:toplevelstmt("}")
+   for i = 1, #proc.parts do
+      local part = proc.parts[i]
+      log.dbg("compiling part #%d", i)
+      emit:stmt("PDCRT_LABEL(«1:contproc», «2:contname»)", proc.id, i)
       toc.comppart(emit, substate, part, i + 1)
       if not part.kreq or contains(FALLS_THROUGHT, part.kreq[1]) then
-         if (i + 1) <= #proc.parts then
-            emit:stmt("PDCRT_CONTINUE(«1:contproc», «2:contname»)", proc.id, i + 1)
-         else
+         if i == #proc.parts then
             emit:stmt("PDCRT_RETURN(0)")
          end
       end
-      emit:closetoplevel("}")
-      log.dbg("finished compilation of continuation")
    end
+   emit:closetoplevel("}")
 end
 
 -- Los IDs de procedimientos por encima de BASE_RESERVED_PROC_IDS están reservados.
@@ -1488,8 +1570,11 @@ end
 function toc.compprocdeclrs(emit, state)
    if state.code then
       emit:toplevelstmt("PDCRT_DECLARE_PROC(«1:localname», «2:procvisibility»)", MAIN_PROC_ID, "private")
+      if #state.code.parts > 0 then
+         emit:toplevelstmt("PDCRT_DECLARE_BODY(«1:localname»)", MAIN_PROC_ID)
+      end
       for kid, part in pairs(state.code.parts) do
-         if kid > 1 then
+         if kid > 1 or toc.hasselftail(state.code) then
             emit:toplevelstmt("PDCRT_DECLARE_CONT(«1:localname», «2:contname»)", MAIN_PROC_ID, kid)
          end
       end
@@ -1503,8 +1588,11 @@ function toc.compprocdeclrs(emit, state)
       end
       local skip_body = proc.pragmas.CNAME and proc.pragmas.IMPORT
       if not skip_body then
+         if #proc.parts > 0 then
+            emit:toplevelstmt("PDCRT_DECLARE_BODY(«1:localname»)", id)
+         end
          for kid, part in pairs(proc.parts) do
-            if kid > 1 then
+            if kid > 1 or toc.hasselftail(proc) then
                emit:toplevelstmt("PDCRT_DECLARE_CONT(«1:localname», «2:contname»)", id, kid)
             end
          end
@@ -1,10 +1,16 @@
 #!/usr/bin/env lunash
 
-alset all_tests fib arit envs par procs str2num txtbuscar fmt boole sumador spush inittonull proccont contbase tailcall retn einit procargs procorder arreglo_comoTexto arreglo_en arreglo_fijarEn arreglo_redimensionar arreglo_clonar variadic variadic_slice objs_creacion objs_atributos modulos cmprefeq cmprefeq-unspec objtag enteros tail-pila arreglo_igualA arreglo_distíntoDe variadic-call rotm objattr objsz
+alset all_tests fib arit envs par procs str2num txtbuscar fmt boole sumador spush inittonull proccont contbase tailcall retn einit procargs procorder arreglo_comoTexto arreglo_en arreglo_fijarEn arreglo_redimensionar arreglo_clonar variadic variadic_slice objs_creacion objs_atributos modulos cmprefeq cmprefeq-unspec objtag enteros tail-pila arreglo_igualA arreglo_distíntoDe variadic-call rotm objattr objsz cache_megamorfica aritmetica_desborde comparaciones recursion_profunda gc_supervivientes tail_propia textos_debiles hash gc_tarjetas gc_mutacion
+alset stress_tests gc_supervivientes gc_tarjetas gc_mutacion textos_debiles cache_megamorfica
+alset failing_tests hash_cero hash_negativo
 alset tests
+alset gc_tests
+alset fail_tests
 
 if $(numeq (arrlen args) 0) [
     aset tests @all_tests
+    aset gc_tests @stress_tests
+    aset fail_tests @failing_tests
 ] [
     aset tests @args
 ]
@@ -24,3 +30,27 @@ for test_name in @tests [
         : @(exit 1)
     ]
 ]
+
+for test_name in @gc_tests [
+    echo Running $test_name with GC stress
+    local status
+    !>status[] env PDCRT_GC_VIVERO=4K PDCRT_GC_CRECIMIENTO=1.0 PDCRT_GC_PASO=1 ./run.sh ./tests/$test_name.pdasm ./tests/$test_name.expected.txt
+    if $(numeq status 0) [
+        echo Success
+    ] [
+        echo Failure
+        : @(exit 1)
+    ]
+]
+
+for test_name in @fail_tests [
+    echo Running $test_name, which must fail
+    local status
+    !>status[] ./run.sh ./tests/$test_name.pdasm /dev/null
+    if $(numeq status 2) [
+        echo Success
+    ] [
+        echo Failure
+        : @(exit 1)
+    ]
+]
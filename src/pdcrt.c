@@ -1,3 +1,9 @@
+// `mremap` y `MAP_ANONYMOUS` son extensiones de GNU (ver
+// `pdcrt_realojar_bloque_grande`).
+#if defined(PDCRT_OPT_GNU) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "pdcrt.h"
 
 #include <assert.h>
@@ -6,14 +12,18 @@
 #include <errno.h>
 
 #ifdef PDCRT_OPT_GNU
-#include <malloc.h>
-#define PDCRT_MALLOC_SIZE(ptr) malloc_usable_size(ptr)
+#include <sys/mman.h>
 #endif
 
 #ifdef PDCRT_PRB_ALOJADOR_INESTABLE
 #include <time.h>
 #endif
 
+#if PDCRT_OPT_GC_HILOS > 0
+#include <threads.h>
+#include <stdatomic.h>
+#endif
+
 // Macro simple de ayuda: emite una llamada a pdcrt_depurar_contexto si
 // PDCRT_DBG_RASTREAR_CONTEXTO está definido o un statment vacío si no.
 #ifdef PDCRT_DBG_RASTREAR_CONTEXTO
@@ -154,70 +164,163 @@ pdcrt_alojador pdcrt_alojador_de_malloc(void)
     return (pdcrt_alojador){ .alojar = &pdcrt_alojador_de_malloc_impl, .datos = NULL };
 }
 
+// El tamaño (en bytes) de los trozos de memoria que pide el alojador de
+// arena. Los bloques de más de un cuarto de esto reciben su propio trozo.
+#define PDCRT_ARENA_TAM_TROZO (64 * 1024)
+
+// Un trozo de memoria de la arena. Sus bloques se alojan uno tras otro en
+// `datos`: alojar uno solo mueve `usado` hacia adelante.
+typedef struct pdcrt_trozo_de_arena
+{
+    struct pdcrt_trozo_de_arena* anterior;
+    size_t capacidad;
+    size_t usado;
+    _Alignas(max_align_t) unsigned char datos[];
+} pdcrt_trozo_de_arena;
+
 typedef struct pdcrt_alojador_de_arena
 {
-    PDCRT_ARR(num_punteros) void** punteros;
-    size_t num_punteros;
+    // El trozo en el que se alojan los bloques pequeños. Los demás trozos
+    // forman una lista mediante `pdcrt_trozo_de_arena.anterior`, en la que
+    // los trozos de los bloques grandes van justo detrás de `actual`.
+    pdcrt_trozo_de_arena* actual;
+    // El último bloque alojado y su trozo. Es el único bloque que puede
+    // crecer o liberarse en su lugar.
+    void* ultimo;
+    pdcrt_trozo_de_arena* trozo_del_ultimo;
+#ifdef PDCRT_DBG_ESTADISTICAS_DE_LOS_ALOJADORES
+    size_t num_alojaciones;
+    size_t num_trozos;
+    size_t total;
+    size_t maxaloj;
+    double suma_de_cuadrados;
+#endif
 } pdcrt_alojador_de_arena;
 
-static void pdcrt_arena_agregar(pdcrt_alojador_de_arena* arena, void* ptr)
+static pdcrt_trozo_de_arena* pdcrt_arena_aloj_trozo(pdcrt_alojador_de_arena* arena, size_t capacidad)
 {
-    void** narena = realloc(arena->punteros, sizeof(void*) * (arena->num_punteros + 1));
-    PDCRT_ASSERT(narena != NULL);
-    narena[arena->num_punteros] = ptr;
-    arena->num_punteros++;
-    arena->punteros = narena;
+    pdcrt_trozo_de_arena* trozo = malloc(sizeof(pdcrt_trozo_de_arena) + capacidad);
+    if(trozo == NULL)
+        return NULL;
+    trozo->anterior = NULL;
+    trozo->capacidad = capacidad;
+    trozo->usado = 0;
+#ifdef PDCRT_DBG_ESTADISTICAS_DE_LOS_ALOJADORES
+    arena->num_trozos++;
+#else
+    (void) arena;
+#endif
+    return trozo;
 }
 
-static void pdcrt_arena_reemplazar(pdcrt_alojador_de_arena* arena, void* ptr, void* nptr)
+// Aloja un bloque nuevo de `tam` bytes, que debe ser un múltiplo del
+// alineamiento de `max_align_t`.
+static void* pdcrt_arena_alojar(pdcrt_alojador_de_arena* arena, size_t tam)
 {
-    for(size_t i = 0; i < arena->num_punteros; i++)
+    pdcrt_trozo_de_arena* trozo = arena->actual;
+    if(tam > PDCRT_ARENA_TAM_TROZO / 4)
     {
-        if(arena->punteros[i] == ptr)
-        {
-            arena->punteros[i] = nptr;
-        }
+        // Así el trozo actual sigue alojando los bloques pequeños.
+        trozo = pdcrt_arena_aloj_trozo(arena, tam);
+        if(trozo == NULL)
+            return NULL;
+        trozo->anterior = arena->actual->anterior;
+        arena->actual->anterior = trozo;
+    }
+    else if(trozo->capacidad - trozo->usado < tam)
+    {
+        trozo = pdcrt_arena_aloj_trozo(arena, PDCRT_ARENA_TAM_TROZO);
+        if(trozo == NULL)
+            return NULL;
+        trozo->anterior = arena->actual;
+        arena->actual = trozo;
     }
+    void* ptr = &trozo->datos[trozo->usado];
+    trozo->usado += tam;
+    arena->ultimo = ptr;
+    arena->trozo_del_ultimo = trozo;
+#ifdef PDCRT_DBG_ESTADISTICAS_DE_LOS_ALOJADORES
+    arena->num_alojaciones++;
+    arena->total += tam;
+    if(tam > arena->maxaloj)
+    {
+        arena->maxaloj = tam;
+    }
+    arena->suma_de_cuadrados += ((double) tam) * ((double) tam);
+#endif
+    return ptr;
 }
 
+// Todas las operaciones son O(1). Solo el último bloque alojado puede
+// crecer sin copiarse o devolver su espacio a la arena; los demás bloques se
+// copian al crecer y su espacio se recupera al destruir la arena.
 static void* pdcrt_alojar_en_arena(void* vdt, void* ptr, size_t tam_viejo, size_t tam_nuevo)
 {
-    pdcrt_alojador_de_arena* dt = vdt;
+    pdcrt_alojador_de_arena* arena = vdt;
+    bool es_el_ultimo = ptr != NULL && ptr == arena->ultimo;
+    pdcrt_trozo_de_arena* trozo = arena->trozo_del_ultimo;
     if(tam_nuevo == 0)
     {
-        // Nada: toda la memoria se liberará cuando se destruya la arena
+        if(es_el_ultimo)
+        {
+            if(trozo == arena->actual)
+            {
+                trozo->usado = (unsigned char*) ptr - trozo->datos;
+            }
+            else
+            {
+                PDCRT_ASSERT(arena->actual->anterior == trozo);
+                arena->actual->anterior = trozo->anterior;
+                free(trozo);
+            }
+            arena->ultimo = NULL;
+            arena->trozo_del_ultimo = NULL;
+        }
         return NULL;
     }
-    else if(tam_viejo == 0)
-    {
+
 #ifdef PDCRT_PRB_ALOJADOR_INESTABLE
-        if(rand() % PDCRT_PRB_ALOJADOR_INESTABLE == 0)
-        {
-            return NULL;
-        }
+    if(rand() % PDCRT_PRB_ALOJADOR_INESTABLE == 0)
+    {
+        return NULL;
+    }
 #endif
-        void* nptr = malloc(tam_nuevo);
-        if(nptr != NULL)
+
+    size_t alineamiento = _Alignof(max_align_t);
+    size_t tam = (tam_nuevo + alineamiento - 1) / alineamiento * alineamiento;
+    if(es_el_ultimo && trozo == arena->actual)
+    {
+        size_t inicio = (unsigned char*) ptr - trozo->datos;
+        if(trozo->capacidad - inicio >= tam)
         {
-            pdcrt_arena_agregar(dt, nptr);
+            trozo->usado = inicio + tam;
+            return ptr;
         }
-        return nptr;
     }
-    else
+    else if(es_el_ultimo)
     {
-#ifdef PDCRT_PRB_ALOJADOR_INESTABLE
-        if(rand() % PDCRT_PRB_ALOJADOR_INESTABLE == 0)
-        {
+        // Un bloque grande es todo su trozo, así que crece con él.
+        PDCRT_ASSERT(arena->actual->anterior == trozo);
+        pdcrt_trozo_de_arena* ntrozo = realloc(trozo, sizeof(pdcrt_trozo_de_arena) + tam);
+        if(ntrozo == NULL)
             return NULL;
-        }
-#endif
-        void* nptr = realloc(ptr, tam_nuevo);
-        if(nptr != NULL)
-        {
-            pdcrt_arena_reemplazar(dt, ptr, nptr);
-        }
-        return nptr;
+        ntrozo->capacidad = ntrozo->usado = tam;
+        arena->actual->anterior = ntrozo;
+        arena->trozo_del_ultimo = ntrozo;
+        arena->ultimo = ntrozo->datos;
+        return ntrozo->datos;
+    }
+    else if(tam_nuevo <= tam_viejo)
+    {
+        return ptr;
+    }
+
+    void* nptr = pdcrt_arena_alojar(arena, tam);
+    if(nptr != NULL && ptr != NULL)
+    {
+        memcpy(nptr, ptr, tam_viejo);
     }
+    return nptr;
 }
 
 pdcrt_error pdcrt_aloj_alojador_de_arena(pdcrt_alojador* aloj)
@@ -228,8 +331,22 @@ pdcrt_error pdcrt_aloj_alojador_de_arena(pdcrt_alojador* aloj)
         PDCRT_ESCRIBIR_ERROR(PDCRT_ENOMEM, __func__);
         return PDCRT_ENOMEM;
     }
-    dt->punteros = NULL;
-    dt->num_punteros = 0;
+#ifdef PDCRT_DBG_ESTADISTICAS_DE_LOS_ALOJADORES
+    dt->num_alojaciones = 0;
+    dt->num_trozos = 0;
+    dt->total = 0;
+    dt->maxaloj = 0;
+    dt->suma_de_cuadrados = 0;
+#endif
+    dt->actual = pdcrt_arena_aloj_trozo(dt, PDCRT_ARENA_TAM_TROZO);
+    if(dt->actual == NULL)
+    {
+        free(dt);
+        PDCRT_ESCRIBIR_ERROR(PDCRT_ENOMEM, __func__);
+        return PDCRT_ENOMEM;
+    }
+    dt->ultimo = NULL;
+    dt->trozo_del_ultimo = NULL;
     aloj->alojar = &pdcrt_alojar_en_arena;
     aloj->datos = dt;
 #if defined(PDCRT_PRB_ALOJADOR_INESTABLE) && !defined(PDCRT_PRB_SRAND)
@@ -247,41 +364,16 @@ void pdcrt_dealoj_alojador_de_arena(pdcrt_alojador aloj)
 {
     pdcrt_alojador_de_arena* arena = aloj.datos;
 #ifdef PDCRT_DBG_ESTADISTICAS_DE_LOS_ALOJADORES
-#ifdef PDCRT_MALLOC_SIZE
-    size_t total = 0, maxaloj = 0;
-    int cant_alojaciones_por_desvstd[3] = {0, 0, 0};
+    size_t total = arena->total, maxaloj = arena->maxaloj;
     double tamprom = 0, var = 0, desvstd = 0;
-    for(size_t i = 0; i < arena->num_punteros; i++)
-    {
-        size_t tam = PDCRT_MALLOC_SIZE(arena->punteros[i]);
-        total += tam;
-        if(tam > maxaloj)
-        {
-            maxaloj = tam;
-        }
-    }
-    tamprom = ((double) total) / ((double) arena->num_punteros);
-    for(size_t i = 0; i < arena->num_punteros; i++)
+    if(arena->num_alojaciones > 0)
     {
-        size_t tam = PDCRT_MALLOC_SIZE(arena->punteros[i]);
-        var += (tam - tamprom) * (tam - tamprom);
-    }
-    var /= arena->num_punteros;
-    desvstd = sqrt(var);
-    for(size_t i = 0; i < arena->num_punteros; i++)
-    {
-        size_t tam = PDCRT_MALLOC_SIZE(arena->punteros[i]);
-        double delta = abs(((double) tam) - tamprom);
-        double ind = delta / desvstd;
-        if(ind <= 1)
-            cant_alojaciones_por_desvstd[0]++;
-        else if(ind <= 2)
-            cant_alojaciones_por_desvstd[1]++;
-        else
-            cant_alojaciones_por_desvstd[2]++;
+        tamprom = ((double) total) / ((double) arena->num_alojaciones);
+        var = arena->suma_de_cuadrados / arena->num_alojaciones - tamprom * tamprom;
+        desvstd = sqrt(var);
     }
     printf(u8"|Desalojando alojador de arena: %zu elementos, %zu bytes en total, máxima alojación de %zu bytes.\n",
-           arena->num_punteros, total, maxaloj);
+           arena->num_alojaciones, total, maxaloj);
     printf(u8"|  Total de %zu bytes, %zu KiB, %zu MiB\n", total, total / 1024, (total / 1024) / 1024);
     printf(u8"|  Máxima alojación de %zu bytes, %zu KiB, %zu MiB\n|\n", maxaloj, maxaloj / 1024, (maxaloj / 1024) / 1024);
 
@@ -289,25 +381,15 @@ void pdcrt_dealoj_alojador_de_arena(pdcrt_alojador aloj)
     printf(u8"|  Varianza: %.2F bytes / %zu bytes\n", var, (size_t) var);
     printf(u8"|  Desviación estándar: %.2F bytes / %zu bytes\n|\n", desvstd, (size_t) desvstd);
 
-    printf(u8"|  %d alojaciones (%.2F%%) tienen 1 desv. std. o menos\n",
-           cant_alojaciones_por_desvstd[0],
-           100 * (((double)cant_alojaciones_por_desvstd[0]) / ((double)arena->num_punteros)));
-    printf(u8"|  %d alojaciones (%.2F%%) tienen más de 1 y menos de 2 desv. std.\n",
-           cant_alojaciones_por_desvstd[1],
-           100 * (((double)cant_alojaciones_por_desvstd[1]) / ((double)arena->num_punteros)));
-    printf(u8"|  %d alojaciones (%.2F%%) tienen más de 2 desv. std.\n",
-           cant_alojaciones_por_desvstd[2],
-           100 * (((double)cant_alojaciones_por_desvstd[2]) / ((double)arena->num_punteros)));
-#else
-    printf(u8"|Desalojando alojador de arena: %zu elementos\n", arena->num_punteros);
-    printf(u8"|  Advertencia: no se pudo solicitar el tamaño en bytes de los elementos\n");
+    printf(u8"|  %zu trozos\n", arena->num_trozos);
 #endif
-#endif
-    for(size_t i = 0; i < arena->num_punteros; i++)
+    pdcrt_trozo_de_arena* trozo = arena->actual;
+    while(trozo != NULL)
     {
-        free(arena->punteros[i]);
+        pdcrt_trozo_de_arena* anterior = trozo->anterior;
+        free(trozo);
+        trozo = anterior;
     }
-    free(arena->punteros);
     free(arena);
 }
 
@@ -351,11 +433,13 @@ pdcrt_error pdcrt_aloj_texto(PDCRT_OUT pdcrt_texto** texto, pdcrt_gc* gc, size_t
         {
             PDCRT_ESCRIBIR_ERROR(PDCRT_ENOMEM, "pdcrt_aloj_texto: alojando el contenido del texto");
             pdcrt_gc_olvidar(gc, (pdcrt_cabecera_gc*) *texto);
-            pdcrt_dealojar_simple(gc->alojador, *texto, sizeof(pdcrt_texto));
             return PDCRT_ENOMEM;
         }
     }
     (*texto)->longitud = lon;
+    (*texto)->selector = PDCRT_SEL_NINGUNO;
+    (*texto)->hash = 0;
+    (*texto)->en_cache = false;
     return PDCRT_OK;
 }
 
@@ -378,7 +462,6 @@ pdcrt_error pdcrt_aloj_texto_desde_c(PDCRT_OUT pdcrt_texto** texto, pdcrt_gc* gc
 void pdcrt_dealoj_texto(pdcrt_alojador alojador, pdcrt_texto* texto)
 {
     pdcrt_dealojar_simple(alojador, texto->contenido, sizeof(char) * texto->longitud);
-    pdcrt_dealojar_simple(alojador, texto, sizeof(pdcrt_texto));
 }
 
 bool pdcrt_textos_son_iguales(pdcrt_texto* a, pdcrt_texto* b)
@@ -449,7 +532,6 @@ pdcrt_error pdcrt_aloj_espacio_de_nombres(pdcrt_gc* gc, PDCRT_OUT pdcrt_espacio_
         if(!p->nombres)
         {
             pdcrt_gc_olvidar(gc, (pdcrt_cabecera_gc*) *espacio);
-            pdcrt_dealojar_simple(gc->alojador, *espacio, sizeof(pdcrt_espacio_de_nombres));
             *espacio = NULL;
             return PDCRT_ENOMEM;
         }
@@ -461,7 +543,6 @@ void pdcrt_dealoj_espacio_de_nombres(pdcrt_alojador alojador, pdcrt_espacio_de_n
 {
     if(espacio->num_nombres > 0)
         pdcrt_dealojar_simple(alojador, espacio->nombres, sizeof(pdcrt_edn_triple) * espacio->num_nombres);
-    pdcrt_dealojar_simple(alojador, espacio, sizeof(pdcrt_espacio_de_nombres));
 }
 
 void pdcrt_agregar_nombre_al_espacio_de_nombres(pdcrt_espacio_de_nombres* espacio, pdcrt_texto* nombre, bool es_autoejecutable, pdcrt_objeto valor)
@@ -501,17 +582,19 @@ pdcrt_error pdcrt_aloj_arreglo(pdcrt_gc* gc, PDCRT_OUT pdcrt_arreglo** arr, size
     if(!(*arr)->elementos)
     {
         pdcrt_gc_olvidar(gc, (pdcrt_cabecera_gc*) *arr);
-        pdcrt_dealojar_simple(gc->alojador, *arr, sizeof(pdcrt_arreglo));
         return PDCRT_ENOMEM;
     }
     (*arr)->longitud = 0;
+    (*arr)->tarjetas = NULL;
+    (*arr)->num_tarjetas = 0;
     return PDCRT_OK;
 }
 
 void pdcrt_dealoj_arreglo(pdcrt_alojador alojador, pdcrt_arreglo* arr)
 {
     pdcrt_dealojar_simple(alojador, arr->elementos, arr->capacidad * sizeof(pdcrt_objeto));
-    pdcrt_dealojar_simple(alojador, arr, sizeof(pdcrt_arreglo));
+    if(arr->tarjetas)
+        pdcrt_dealojar_simple(alojador, arr->tarjetas, arr->num_tarjetas);
 }
 
 pdcrt_error pdcrt_aloj_arreglo_vacio(pdcrt_gc* gc, PDCRT_OUT pdcrt_arreglo** arr)
@@ -744,100 +827,249 @@ pdcrt_continuacion pdcrt_continuacion_tail_enviar_mensaje(
     return cont;
 }
 
-// PDCRT_TAM_PILA_DE_CONTINUACIONES es el nuḿero de marcos que estan en la
-// pila. Si cambias su valor, asegúrate de cambiar la prueba
-// `tests/tailcall.pdasm`.
-#define PDCRT_TAM_PILA_DE_CONTINUACIONES 512
-void pdcrt_trampolin(struct pdcrt_marco* marco, pdcrt_continuacion k)
+// Pila de continuaciones:
+
+static pdcrt_segmento_de_continuaciones* pdcrt_aloj_segmento_de_continuaciones(
+    pdcrt_contexto* contexto,
+    PDCRT_NULL pdcrt_segmento_de_continuaciones* anterior
+)
 {
-    pdcrt_continuacion pila[PDCRT_TAM_PILA_DE_CONTINUACIONES] = {0};
-    pdcrt_marco marcos[PDCRT_TAM_PILA_DE_CONTINUACIONES] = {0};
-    pila[0] = k;
-    marcos[0] = *marco;
-    size_t tam_pila = 1;
-    while(tam_pila > 0)
+    pdcrt_segmento_de_continuaciones* seg = pdcrt_alojar(contexto, sizeof(pdcrt_segmento_de_continuaciones));
+    if(!seg)
     {
-        // El -2 es porque las acciones PDCRT_CONT_INICIAR y
-        // PDCRT_CONT_ENVIAR_MENSAJE requieren dos espacios en la pila (uno
-        // para la continuación actual, otro para la nueva función).
-        if(tam_pila >= (PDCRT_TAM_PILA_DE_CONTINUACIONES - 2))
-        {
-            fprintf(stderr, u8"Límite de recursión alcanzado: %zu llamadas recursivas\n", tam_pila);
-            pdcrt_abort();
-        }
+        PDCRT_ESCRIBIR_ERROR(PDCRT_ENOMEM, "pdcrt_trampolin: alojando un segmento de la pila de continuaciones");
+        no_falla(PDCRT_ENOMEM);
+    }
+    seg->anterior = anterior;
+    seg->siguiente = NULL;
+    return seg;
+}
+
+static void pdcrt_inic_pila_de_continuaciones(pdcrt_pila_de_continuaciones* pila, pdcrt_marco* marco_base)
+{
+    pila->primero = pdcrt_aloj_segmento_de_continuaciones(marco_base->contexto, NULL);
+    pila->actual = pila->primero;
+    pila->num_en_actual = 0;
+    pila->num_elementos = 0;
+    pila->marco_base = marco_base;
+}
+
+static void pdcrt_deinic_pila_de_continuaciones(pdcrt_pila_de_continuaciones* pila)
+{
+    pdcrt_contexto* contexto = pila->marco_base->contexto;
+    for(pdcrt_segmento_de_continuaciones* seg = pila->primero; seg != NULL;)
+    {
+        pdcrt_segmento_de_continuaciones* sig = seg->siguiente;
+        pdcrt_dealojar(contexto, seg, sizeof(pdcrt_segmento_de_continuaciones));
+        seg = sig;
+    }
+    pila->primero = pila->actual = NULL;
+    pila->num_en_actual = pila->num_elementos = 0;
+}
 
-        if(pdcrt_deberia_recolectar_basura(&marco->contexto->gc))
+// Agrega un elemento a la pila y devuelve su marco. La continuación del nuevo
+// elemento no es inicializada.
+static pdcrt_marco* pdcrt_pila_de_continuaciones_empujar(pdcrt_pila_de_continuaciones* pila)
+{
+    pdcrt_contexto* contexto = pila->marco_base->contexto;
+    if(pila->num_elementos >= contexto->limite_de_recursion)
+    {
+        fprintf(stderr, u8"Límite de recursión alcanzado: %zu llamadas recursivas\n", pila->num_elementos);
+        pdcrt_abort();
+    }
+    if(pila->num_en_actual == PDCRT_TAM_SEGMENTO_DE_CONTINUACIONES)
+    {
+        if(!pila->actual->siguiente)
         {
-            pdcrt_recolectar_basura(marcos, tam_pila, &marcos[tam_pila - 1], pila, tam_pila);
+            pila->actual->siguiente = pdcrt_aloj_segmento_de_continuaciones(contexto, pila->actual);
         }
+        pila->actual = pila->actual->siguiente;
+        pila->num_en_actual = 0;
+    }
+    pila->num_en_actual += 1;
+    pila->num_elementos += 1;
+    return &pila->actual->marcos[pila->num_en_actual - 1];
+}
+
+static void pdcrt_pila_de_continuaciones_sacar(pdcrt_pila_de_continuaciones* pila)
+{
+    PDCRT_ASSERT(pila->num_elementos > 0);
+    pila->num_en_actual -= 1;
+    pila->num_elementos -= 1;
+    if(pila->num_en_actual == 0 && pila->actual->anterior)
+    {
+        pila->actual = pila->actual->anterior;
+        pila->num_en_actual = PDCRT_TAM_SEGMENTO_DE_CONTINUACIONES;
+    }
+}
+
+static pdcrt_continuacion* pdcrt_pila_de_continuaciones_tope(pdcrt_pila_de_continuaciones* pila)
+{
+    PDCRT_ASSERT(pila->num_en_actual > 0);
+    return &pila->actual->continuaciones[pila->num_en_actual - 1];
+}
+
+static pdcrt_marco* pdcrt_pila_de_continuaciones_marco_del_tope(pdcrt_pila_de_continuaciones* pila)
+{
+    PDCRT_ASSERT(pila->num_en_actual > 0);
+    if(pila->num_elementos == 1)
+    {
+        return pila->marco_base;
+    }
+    else
+    {
+        return &pila->actual->marcos[pila->num_en_actual - 1];
+    }
+}
+
+// El trampolín tiene dos formas de despachar las continuaciones: si
+// `PDCRT_OPT_GNU` está definido se usa "direct threading" mediante las
+// "labels as values" de GCC (cada caso salta directamente al siguiente), si
+// no, un `switch` dentro de un bucle. Ambas formas comparten el cuerpo de cada
+// caso mediante las siguientes macros:
+//
+// - `PDCRT_TRAMPOLIN_CASO(tipo)`: La etiqueta del caso para `tipo`.
+//
+// - `PDCRT_TRAMPOLIN_SIGUIENTE()`: Termina el caso actual y ejecuta la
+//   siguiente continuación (o sale del trampolín si la pila está vacía).
+//
+// La recolección de basura solo se revisa en los "puntos seguros" (ver
+// `PDCRT_TRAMPOLIN_PUNTO_SEGURO`): antes de llamar a una función y antes de
+// continuar dentro de un procedimiento. Las alojaciones solo marcan que la
+// recolección es necesaria (ver `pdcrt_gc_alojar`) y el límite de recursión
+// se revisa al empujar en la pila.
+#ifdef PDCRT_OPT_GNU
+#define PDCRT_TRAMPOLIN_CASO(tipo) pdcrt_trampolin_caso_##tipo
+#define PDCRT_TRAMPOLIN_SIGUIENTE()                             \
+    do                                                          \
+    {                                                           \
+        if(pila.num_elementos == 0)                             \
+            goto pdcrt_trampolin_fin;                           \
+        sk = *pdcrt_pila_de_continuaciones_tope(&pila);         \
+        goto *casos[sk.tipo];                                   \
+    }                                                           \
+    while(0)
+#else
+#define PDCRT_TRAMPOLIN_CASO(tipo) case tipo
+#define PDCRT_TRAMPOLIN_SIGUIENTE() continue
+#endif
+
+#define PDCRT_TRAMPOLIN_PUNTO_SEGURO()                                  \
+    do                                                                  \
+    {                                                                   \
+        if(pdcrt_deberia_recolectar_basura(&marco->contexto->gc))       \
+        {                                                               \
+            pdcrt_recolectar_basura(&pila, pdcrt_pila_de_continuaciones_marco_del_tope(&pila)); \
+            /* La recolección pudo mover los objetos de `sk`. */        \
+            sk = *pdcrt_pila_de_continuaciones_tope(&pila);             \
+        }                                                               \
+    }                                                                   \
+    while(0)
 
-        pdcrt_continuacion sk = pila[tam_pila - 1];
+void pdcrt_trampolin(struct pdcrt_marco* marco, pdcrt_continuacion k)
+{
+    pdcrt_pila_de_continuaciones pila;
+    pdcrt_inic_pila_de_continuaciones(&pila, marco);
+    pdcrt_pila_de_continuaciones_empujar(&pila);
+    *pdcrt_pila_de_continuaciones_tope(&pila) = k;
+    pdcrt_continuacion sk;
+#ifdef PDCRT_OPT_GNU
+    static void* const casos[] = {
+        [PDCRT_CONT_INICIAR] = &&PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_INICIAR),
+        [PDCRT_CONT_CONTINUAR] = &&PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_CONTINUAR),
+        [PDCRT_CONT_DEVOLVER] = &&PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_DEVOLVER),
+        [PDCRT_CONT_ENVIAR_MENSAJE] = &&PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_ENVIAR_MENSAJE),
+        [PDCRT_CONT_TAIL_INICIAR] = &&PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_TAIL_INICIAR),
+        [PDCRT_CONT_TAIL_ENVIAR_MENSAJE] = &&PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_TAIL_ENVIAR_MENSAJE),
+    };
+    PDCRT_TRAMPOLIN_SIGUIENTE();
+#else
+    while(pila.num_elementos > 0)
+    {
+        sk = *pdcrt_pila_de_continuaciones_tope(&pila);
         switch(sk.tipo)
         {
-        case PDCRT_CONT_INICIAR:
+#endif
+        PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_INICIAR):
         {
+            PDCRT_TRAMPOLIN_PUNTO_SEGURO();
             pdcrt_proc_t fproc = (pdcrt_proc_t) sk.valor.iniciar.proc;
             pdcrt_proc_continuacion kproc = (pdcrt_proc_continuacion) sk.valor.iniciar.cont;
-            pila[tam_pila - 1] = pdcrt_continuacion_normal(kproc, sk.valor.iniciar.marco_superior);
-            pila[tam_pila] = (*fproc)(
-                &marcos[tam_pila],
+            *pdcrt_pila_de_continuaciones_tope(&pila) = pdcrt_continuacion_normal(kproc, sk.valor.iniciar.marco_superior);
+            pdcrt_marco* nuevo = pdcrt_pila_de_continuaciones_empujar(&pila);
+            *pdcrt_pila_de_continuaciones_tope(&pila) = (*fproc)(
+                nuevo,
                 sk.valor.iniciar.marco_superior,
                 sk.valor.iniciar.args,
                 sk.valor.iniciar.rets);
-            tam_pila += 1;
-            break;
+            PDCRT_TRAMPOLIN_SIGUIENTE();
         }
-        case PDCRT_CONT_CONTINUAR:
+        PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_CONTINUAR):
         {
+            PDCRT_TRAMPOLIN_PUNTO_SEGURO();
             pdcrt_proc_continuacion kproc = (pdcrt_proc_continuacion) sk.valor.continuar.proc;
-            pila[tam_pila - 1] = (*kproc)(sk.valor.continuar.marco_actual);
-            break;
+            *pdcrt_pila_de_continuaciones_tope(&pila) = (*kproc)(sk.valor.continuar.marco_actual);
+            PDCRT_TRAMPOLIN_SIGUIENTE();
         }
-        case PDCRT_CONT_ENVIAR_MENSAJE:
+        PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_ENVIAR_MENSAJE):
         {
+            PDCRT_TRAMPOLIN_PUNTO_SEGURO();
             pdcrt_proc_continuacion kproc = (pdcrt_proc_continuacion) sk.valor.enviar_mensaje.recv;
-            pila[tam_pila - 1] = pdcrt_continuacion_normal(kproc, sk.valor.enviar_mensaje.marco);
-            pila[tam_pila] = PDCRT_CONV_RECV(sk.valor.enviar_mensaje.yo.recv)(
-                &marcos[tam_pila],
+            *pdcrt_pila_de_continuaciones_tope(&pila) = pdcrt_continuacion_normal(kproc, sk.valor.enviar_mensaje.marco);
+            pdcrt_marco* nuevo = pdcrt_pila_de_continuaciones_empujar(&pila);
+            *pdcrt_pila_de_continuaciones_tope(&pila) = PDCRT_CONV_RECV(sk.valor.enviar_mensaje.yo.recv)(
+                nuevo,
                 sk.valor.enviar_mensaje.marco,
                 sk.valor.enviar_mensaje.yo,
                 sk.valor.enviar_mensaje.mensaje,
                 sk.valor.enviar_mensaje.args,
                 sk.valor.enviar_mensaje.rets);
-            tam_pila += 1;
-            break;
+            PDCRT_TRAMPOLIN_SIGUIENTE();
         }
-        case PDCRT_CONT_DEVOLVER:
-            pdcrt_deinic_marco(&marcos[tam_pila - 1]);
-            tam_pila -= 1;
-            break;
-        case PDCRT_CONT_TAIL_INICIAR:
+        PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_DEVOLVER):
+        {
+            pdcrt_deinic_marco(pdcrt_pila_de_continuaciones_marco_del_tope(&pila));
+            pdcrt_pila_de_continuaciones_sacar(&pila);
+            PDCRT_TRAMPOLIN_SIGUIENTE();
+        }
+        PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_TAIL_INICIAR):
         {
-            pdcrt_deinic_marco(&marcos[tam_pila - 1]);
+            PDCRT_TRAMPOLIN_PUNTO_SEGURO();
+            pdcrt_marco* actual = pdcrt_pila_de_continuaciones_marco_del_tope(&pila);
+            pdcrt_deinic_marco(actual);
             pdcrt_proc_t fproc = (pdcrt_proc_t) sk.valor.tail_iniciar.proc;
-            pila[tam_pila - 1] = (*fproc)(
-                &marcos[tam_pila - 1],
+            *pdcrt_pila_de_continuaciones_tope(&pila) = (*fproc)(
+                actual,
                 sk.valor.tail_iniciar.marco_superior,
                 sk.valor.tail_iniciar.args,
                 sk.valor.tail_iniciar.rets);
-            break;
+            PDCRT_TRAMPOLIN_SIGUIENTE();
         }
-        case PDCRT_CONT_TAIL_ENVIAR_MENSAJE:
+        PDCRT_TRAMPOLIN_CASO(PDCRT_CONT_TAIL_ENVIAR_MENSAJE):
         {
-            pdcrt_deinic_marco(&marcos[tam_pila - 1]);
-            pila[tam_pila - 1] = PDCRT_CONV_RECV(sk.valor.tail_enviar_mensaje.yo.recv)(
-                &marcos[tam_pila - 1],
+            PDCRT_TRAMPOLIN_PUNTO_SEGURO();
+            pdcrt_marco* actual = pdcrt_pila_de_continuaciones_marco_del_tope(&pila);
+            pdcrt_deinic_marco(actual);
+            *pdcrt_pila_de_continuaciones_tope(&pila) = PDCRT_CONV_RECV(sk.valor.tail_enviar_mensaje.yo.recv)(
+                actual,
                 sk.valor.tail_enviar_mensaje.marco_superior,
                 sk.valor.tail_enviar_mensaje.yo,
                 sk.valor.tail_enviar_mensaje.mensaje,
                 sk.valor.tail_enviar_mensaje.args,
                 sk.valor.tail_enviar_mensaje.rets);
-            break;
+            PDCRT_TRAMPOLIN_SIGUIENTE();
         }
+#ifdef PDCRT_OPT_GNU
+pdcrt_trampolin_fin:
+#else
         }
     }
+#endif
+    pdcrt_deinic_pila_de_continuaciones(&pila);
 }
-#undef PDCRT_TAM_PILA_DE_CONTINUACIONES
+#undef PDCRT_TRAMPOLIN_CASO
+#undef PDCRT_TRAMPOLIN_SIGUIENTE
+#undef PDCRT_TRAMPOLIN_PUNTO_SEGURO
 
 
 // Entornos:
@@ -857,11 +1089,6 @@ pdcrt_error pdcrt_aloj_env(PDCRT_OUT pdcrt_env** env, pdcrt_gc* gc, size_t env_s
     }
 }
 
-void pdcrt_dealoj_env(pdcrt_env* env, pdcrt_alojador alojador)
-{
-    pdcrt_dealojar_simple(alojador, env, sizeof(pdcrt_env) + sizeof(pdcrt_objeto) * env->env_size);
-}
-
 
 // Objetos:
 
@@ -1223,8 +1450,8 @@ static bool pdcrt_comparar_entero_y_float(pdcrt_entero e, pdcrt_float f, enum pd
     }
 
     // Debido a (1), sabemos que PDCRT_FLOAT_DIG_SIG < PDCRT_ENTERO_BITS
-    const pdcrt_entero max_entero_repr_float = (1U << PDCRT_FLOAT_DIG_SIG) - 1U;
-    const pdcrt_entero min_entero_repr_float = -(1U << PDCRT_FLOAT_DIG_SIG);
+    const pdcrt_entero max_entero_repr_float = ((pdcrt_entero) 1 << PDCRT_FLOAT_DIG_SIG) - 1;
+    const pdcrt_entero min_entero_repr_float = -((pdcrt_entero) 1 << PDCRT_FLOAT_DIG_SIG);
 
     if((e >= min_entero_repr_float) && (e <= max_entero_repr_float))
     {
@@ -1264,14 +1491,14 @@ static bool pdcrt_comparar_entero_y_float(pdcrt_entero e, pdcrt_float f, enum pd
         case PDCRT_IGUAL_A:
             // Un float "normal" como 2.4 jamás será igual a un entero.
             return false;
-        case PDCRT_MAYOR_O_IGUAL_A:
-            // `e >= f` => `e >= floor(f)`
+        case PDCRT_MENOR_O_IGUAL_A:
+            // `e <= f` => `e <= floor(f)`
         case PDCRT_MAYOR_QUE:
             // `e > f` => `e > floor(f)`
             f_ent = f_floor;
             break;
-        case PDCRT_MENOR_O_IGUAL_A:
-            // `e <= f` => `e <= ceil(f)`
+        case PDCRT_MAYOR_O_IGUAL_A:
+            // `e >= f` => `e >= ceil(f)`
         case PDCRT_MENOR_QUE:
             // `e < f` => `e < ceil(f)`
             f_ent = PDCRT_FLOAT_CEIL(f);
@@ -1288,10 +1515,11 @@ static bool pdcrt_comparar_entero_y_float(pdcrt_entero e, pdcrt_float f, enum pd
 
     // Además, como es positivo, el exponente es la cantidad de bits antes
     // del punto decimal (¿punto decimal? ¿o punto binario?).
-    if(f_bits > PDCRT_ENTERO_BITS)
+    if(f_bits > PDCRT_ENTERO_BITS || (f_bits == PDCRT_ENTERO_BITS && f_ent > 0))
     {
-        // `f` es más grande o más pequeño que cualquier entero.
-        return (f_ent > 0) ? op == PDCRT_MENOR_QUE : op == PDCRT_MAYOR_QUE;
+        // `f` es más grande o más pequeño que cualquier entero. 2^63 tiene 64
+        // bits pero no cabe en un entero, -2^63 sí.
+        return (f_ent > 0) ? pdcrt_es_menor_que(op) : pdcrt_es_mayor_que(op);
     }
     else
     {
@@ -1305,7 +1533,7 @@ static bool pdcrt_comparar_entero_y_float(pdcrt_entero e, pdcrt_float f, enum pd
     }
 }
 
-bool pdcrt_objeto_iguales(pdcrt_objeto a, pdcrt_objeto b)
+bool pdcrt_objeto_escalar_iguales(pdcrt_objeto a, pdcrt_objeto b)
 {
     if(a.tag != b.tag)
     {
@@ -1375,65 +1603,186 @@ bool pdcrt_objeto_identicos(pdcrt_objeto a, pdcrt_objeto b)
 
 // Hasheo:
 
-static pdcrt_entero pdcrt_hashear_bytes(const char* bytes, size_t longitud, pdcrt_uentero n)
+// Multiplica `a` por `b` (como enteros de 128 bits) y devuelve la parte
+// baja del resultado en `a` y la alta en `b`.
+static void pdcrt_mum(uint64_t* a, uint64_t* b)
 {
-    pdcrt_uentero hash = 0;
-    for(size_t i = 0; i < longitud; i++)
-    {
-        unsigned char c = bytes[i];
-        hash = ((hash << 8) + c) * (pdcrt_uentero) n;
-    }
-    return hash % (pdcrt_uentero) n;
+#ifdef PDCRT_OPT_GNU
+    unsigned __int128 r = (unsigned __int128) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, la = (uint32_t) *a, hb = *b >> 32, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
 }
 
-pdcrt_entero pdcrt_hashear_objeto(pdcrt_objeto obj, pdcrt_uentero n)
+static uint64_t pdcrt_mezclar(uint64_t a, uint64_t b)
 {
-    switch(obj.tag)
+    pdcrt_mum(&a, &b);
+    return a ^ b;
+}
+
+static uint64_t pdcrt_leer8(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t pdcrt_leer4(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+uint64_t pdcrt_hash_de_bytes(const void* bytes, size_t longitud)
+{
+    static const uint64_t s[4] = {
+        UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+        UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47),
+    };
+    const unsigned char* p = bytes;
+    uint64_t semilla = pdcrt_mezclar(s[0], s[1]);
+    uint64_t a, b;
+    if(longitud <= 16)
     {
-    case PDCRT_TOBJ_ENTERO:
-        return obj.value.i % n;
-    case PDCRT_TOBJ_FLOAT:
-        if(isnan(obj.value.f))
+        if(longitud >= 4)
         {
-            return n / 3;
+            size_t m = (longitud >> 3) << 2;
+            a = (pdcrt_leer4(p) << 32) | pdcrt_leer4(p + m);
+            b = (pdcrt_leer4(p + longitud - 4) << 32) | pdcrt_leer4(p + longitud - 4 - m);
         }
-        else if(isinf(obj.value.f))
+        else if(longitud > 0)
         {
-            return (obj.value.f < 0) ? 0 : (n - 1);
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[longitud >> 1] << 8) | p[longitud - 1];
+            b = 0;
         }
         else
         {
-            int exp;
-            PDCRT_FLOAT_FREXP(obj.value.f, &exp);
-            if(exp > 0 && ((size_t) exp) < PDCRT_ENTERO_BITS)
-            {
-                return ((pdcrt_entero) obj.value.f) % n;
-            }
-            else if(exp > 0)
-            {
-                return ((pdcrt_entero) PDCRT_FLOAT_FMOD(obj.value.f, (pdcrt_float) n)) % n;
-            }
-            else
+            a = b = 0;
+        }
+    }
+    else
+    {
+        size_t i = longitud;
+        if(i >= 48)
+        {
+            uint64_t semilla1 = semilla, semilla2 = semilla;
+            do
             {
-                PDCRT_ASSERT(exp <= 0);
-                return pdcrt_hashear_bytes((const char*)&obj.value.f, sizeof(obj.value.f), n);
+                semilla = pdcrt_mezclar(pdcrt_leer8(p) ^ s[1], pdcrt_leer8(p + 8) ^ semilla);
+                semilla1 = pdcrt_mezclar(pdcrt_leer8(p + 16) ^ s[2], pdcrt_leer8(p + 24) ^ semilla1);
+                semilla2 = pdcrt_mezclar(pdcrt_leer8(p + 32) ^ s[3], pdcrt_leer8(p + 40) ^ semilla2);
+                p += 48;
+                i -= 48;
             }
+            while(i >= 48);
+            semilla ^= semilla1 ^ semilla2;
+        }
+        while(i > 16)
+        {
+            semilla = pdcrt_mezclar(pdcrt_leer8(p) ^ s[1], pdcrt_leer8(p + 8) ^ semilla);
+            i -= 16;
+            p += 16;
         }
+        a = pdcrt_leer8(p + i - 16);
+        b = pdcrt_leer8(p + i - 8);
+    }
+    a ^= s[1];
+    b ^= semilla;
+    pdcrt_mum(&a, &b);
+    return pdcrt_mezclar(a ^ s[0] ^ longitud, b ^ s[1]);
+}
+
+// Mezcla los bits de `x` (es el "finalizador" de MurmurHash3).
+static uint64_t pdcrt_finalizar_hash(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33;
+    x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    x ^= x >> 33;
+    return x;
+}
+
+// Como `pdcrt_hash_de_bytes`, pero nunca devuelve 0 ni 1: esos valores
+// marcan las ranuras vacías y borradas de `pdcrt_tabla_de_textos`.
+static uint64_t pdcrt_hash_de_contenido(const char* str, size_t len)
+{
+    uint64_t hash = pdcrt_hash_de_bytes(str, len);
+    if(hash <= PDCRT_RANURA_DE_TEXTOS_BORRADA)
+        hash += 2;
+    return hash;
+}
+
+uint64_t pdcrt_hash_de_texto(pdcrt_texto* texto)
+{
+    if(texto->hash == 0)
+        texto->hash = pdcrt_hash_de_contenido(texto->contenido, texto->longitud);
+    return texto->hash;
+}
+
+uint64_t pdcrt_hash_de_objeto(pdcrt_objeto obj)
+{
+    switch(obj.tag)
+    {
+    case PDCRT_TOBJ_ENTERO:
+        return pdcrt_finalizar_hash((uint64_t) obj.value.i);
+    case PDCRT_TOBJ_FLOAT:
+    {
+        pdcrt_float f = obj.value.f, ent;
+        if(isnan(f))
+            return pdcrt_finalizar_hash(UINT64_C(0x7ff8000000000000));
+        // -(PDCRT_ENTERO_MIN) es una potencia de 2, así que es exacto como float.
+        if(PDCRT_FLOAT_MODF(f, &ent) == 0
+           && f >= (pdcrt_float) PDCRT_ENTERO_MIN
+           && f < -(pdcrt_float) PDCRT_ENTERO_MIN)
+            return pdcrt_finalizar_hash((uint64_t) (pdcrt_entero) f);
+        return pdcrt_hash_de_bytes(&f, sizeof(f));
+    }
     case PDCRT_TOBJ_BOOLEANO:
-        return obj.value.b? 0 : (n - 1);
+        return pdcrt_finalizar_hash(obj.value.b? 1 : 2);
     case PDCRT_TOBJ_NULO:
-        return n / 2;
+        return pdcrt_finalizar_hash(3);
     case PDCRT_TOBJ_MARCA_DE_PILA:
-        return n - 1;
+        return pdcrt_finalizar_hash(4);
     case PDCRT_TOBJ_TEXTO:
-        return pdcrt_hashear_bytes(obj.value.t->contenido, obj.value.t->longitud, n);
+        return pdcrt_hash_de_texto(obj.value.t);
     case PDCRT_TOBJ_VOIDPTR:
-        return ((pdcrt_entero) obj.value.p) % n;
+        return pdcrt_finalizar_hash((uint64_t) (uintptr_t) obj.value.p);
     default:
         pdcrt_inalcanzable();
     }
 }
 
+pdcrt_entero pdcrt_hashear_objeto(pdcrt_objeto obj, pdcrt_uentero n)
+{
+    return (pdcrt_entero) (pdcrt_hash_de_objeto(obj) % n);
+}
+
+// Saca de la pila el argumento `n` de `hashPara`. Debe ser un entero mayor que
+// 0: con 0 no hay resultados posibles y con un negativo el rango no tendría
+// sentido.
+static pdcrt_uentero pdcrt_sacar_rango_de_hash(pdcrt_contexto* ctx)
+{
+    pdcrt_objeto on = pdcrt_sacar_de_pila(&ctx->pila);
+    pdcrt_objeto_debe_tener_tipo(on, PDCRT_TOBJ_ENTERO);
+    if(on.value.i <= 0)
+    {
+        fprintf(stderr, "Error: hashPara necesita un entero mayor que 0, pero recibió " PDCRT_ENTERO_FMT ".\n", on.value.i);
+        pdcrt_abort();
+    }
+    return (pdcrt_uentero) on.value.i;
+}
+
 
 struct pdcrt_constructor_de_texto
 {
@@ -1555,180 +1904,242 @@ static pdcrt_objeto pdcrt_closure_desde_callback_del_runtime(pdcrt_marco* marco,
     return clz;
 }
 
+// Devuelve la comparación equivalente a `op` con los operandos
+// intercambiados: `a < b` es lo mismo que `b > a`.
 static enum pdcrt_comparacion pdcrt_invertir_comparacion(enum pdcrt_comparacion op)
 {
     switch(op)
     {
     case PDCRT_MENOR_QUE:
-        return PDCRT_MAYOR_O_IGUAL_A;
-    case PDCRT_MENOR_O_IGUAL_A:
         return PDCRT_MAYOR_QUE;
+    case PDCRT_MENOR_O_IGUAL_A:
+        return PDCRT_MAYOR_O_IGUAL_A;
     case PDCRT_MAYOR_QUE:
-        return PDCRT_MENOR_O_IGUAL_A;
-    case PDCRT_MAYOR_O_IGUAL_A:
         return PDCRT_MENOR_QUE;
+    case PDCRT_MAYOR_O_IGUAL_A:
+        return PDCRT_MENOR_O_IGUAL_A;
     case PDCRT_IGUAL_A:
         return PDCRT_IGUAL_A;
     }
     pdcrt_inalcanzable();
 }
 
-static void pdcrt_comparar_numeros(pdcrt_marco* marco, pdcrt_objeto yo, int args, int rets, enum pdcrt_comparacion op)
+// Compara dos números `yo` y `rhs` (que deben ser enteros o floats).
+static bool pdcrt_comparar_escalares_numericos(pdcrt_objeto yo, pdcrt_objeto rhs, enum pdcrt_comparacion op)
 {
     enum pdcrt_comparacion rop = pdcrt_invertir_comparacion(op);
-    pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
-    pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-    pdcrt_objeto_debe_tener_uno_de_los_tipos(marco, rhs, PDCRT_TOBJ_ENTERO, PDCRT_TOBJ_FLOAT);
     switch(yo.tag)
     {
     case PDCRT_TOBJ_ENTERO:
         switch(rhs.tag)
         {
         case PDCRT_TOBJ_ENTERO:
-            no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_comparar_enteros(yo.value.i, rhs.value.i, op))));
-            break;
+            return pdcrt_comparar_enteros(yo.value.i, rhs.value.i, op);
         case PDCRT_TOBJ_FLOAT:
-            no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_comparar_entero_y_float(yo.value.i, rhs.value.f, op))));
-            break;
+            return pdcrt_comparar_entero_y_float(yo.value.i, rhs.value.f, op);
         default:
             pdcrt_inalcanzable();
         }
-        break;
     case PDCRT_TOBJ_FLOAT:
         switch(rhs.tag)
         {
         case PDCRT_TOBJ_ENTERO:
-            no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_comparar_entero_y_float(rhs.value.i, yo.value.f, rop))));
-            break;
+            return pdcrt_comparar_entero_y_float(rhs.value.i, yo.value.f, rop);
         case PDCRT_TOBJ_FLOAT:
-            no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_comparar_floats(yo.value.f, rhs.value.f, op))));
-            break;
+            return pdcrt_comparar_floats(yo.value.f, rhs.value.f, op);
         default:
             pdcrt_inalcanzable();
         }
-        break;
     default:
         pdcrt_inalcanzable();
     }
+}
+
+static void pdcrt_comparar_numeros(pdcrt_marco* marco, pdcrt_objeto yo, int args, int rets, enum pdcrt_comparacion op)
+{
+    pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
+    pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
+    pdcrt_objeto_debe_tener_uno_de_los_tipos(marco, rhs, PDCRT_TOBJ_ENTERO, PDCRT_TOBJ_FLOAT);
+    bool res = pdcrt_comparar_escalares_numericos(yo, rhs, op);
+    no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(res)));
     pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
 }
 
-pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
+enum pdcrt_operacion_aritmetica
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
-    marco->nombre = u8"método de Numero";
-    pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
+    PDCRT_SUMA,
+    PDCRT_RESTA,
+    PDCRT_MULTIPLICACION,
+    PDCRT_DIVISION
+};
 
-#define PDCRT_NUMOP(op, ffn, efn)                                       \
-    do                                                                  \
-    {                                                                   \
-        pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);      \
-        pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila); \
-        pdcrt_objeto_debe_tener_uno_de_los_tipos(marco, rhs, PDCRT_TOBJ_ENTERO, PDCRT_TOBJ_FLOAT); \
-        switch(rhs.tag)                                                 \
-        {                                                               \
-        case PDCRT_TOBJ_ENTERO:                                         \
-            switch(yo.tag)                                              \
-            {                                                           \
-            case PDCRT_TOBJ_ENTERO:                                     \
-                no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, efn(yo.value.i op rhs.value.i))); \
-                break;                                                  \
-            case PDCRT_TOBJ_FLOAT:                                      \
-                no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, ffn(yo.value.f op ((pdcrt_float)rhs.value.i)))); \
-                break;                                                  \
-            default:                                                    \
-                pdcrt_inalcanzable();                                   \
-            }                                                           \
-            break;                                                      \
-        case PDCRT_TOBJ_FLOAT:                                          \
-            switch(yo.tag)                                              \
-            {                                                           \
-            case PDCRT_TOBJ_ENTERO:                                     \
-                no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, ffn(((pdcrt_float)yo.value.i) op rhs.value.f))); \
-                break;                                                  \
-            case PDCRT_TOBJ_FLOAT:                                      \
-                no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, ffn(yo.value.f op rhs.value.f))); \
-                break;                                                  \
-            default:                                                    \
-                pdcrt_inalcanzable();                                   \
-            }                                                           \
-            break;                                                      \
-        default:                                                        \
-            pdcrt_inalcanzable();                                       \
-        }                                                               \
-    } while(0)
+// Las siguientes funciones realizan la operación y devuelven `false` si el
+// resultado no cabe en un `pdcrt_entero`.
 
-    if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_mas) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_sumar))
-    {
-        PDCRT_NUMOP(+, pdcrt_objeto_float, pdcrt_objeto_entero);
-        pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
-        return pdcrt_continuacion_devolver();
-    }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_menos) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_restar))
-    {
-        PDCRT_NUMOP(-, pdcrt_objeto_float, pdcrt_objeto_entero);
-        pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
-        return pdcrt_continuacion_devolver();
-    }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_por) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_multiplicar))
-    {
-        PDCRT_NUMOP(*, pdcrt_objeto_float, pdcrt_objeto_entero);
-        pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
-        return pdcrt_continuacion_devolver();
+static bool pdcrt_sumar_enteros(pdcrt_entero a, pdcrt_entero b, PDCRT_OUT pdcrt_entero* res)
+{
+    if((b > 0 && a > PDCRT_ENTERO_MAX - b) || (b < 0 && a < PDCRT_ENTERO_MIN - b))
+        return false;
+    *res = a + b;
+    return true;
+}
+
+static bool pdcrt_restar_enteros(pdcrt_entero a, pdcrt_entero b, PDCRT_OUT pdcrt_entero* res)
+{
+    if((b < 0 && a > PDCRT_ENTERO_MAX + b) || (b > 0 && a < PDCRT_ENTERO_MIN + b))
+        return false;
+    *res = a - b;
+    return true;
+}
+
+static bool pdcrt_multiplicar_enteros(pdcrt_entero a, pdcrt_entero b, PDCRT_OUT pdcrt_entero* res)
+{
+    if(a > 0)
+    {
+        if((b > 0 && a > PDCRT_ENTERO_MAX / b) || (b <= 0 && b < PDCRT_ENTERO_MIN / a))
+            return false;
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_entre) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_dividir))
+    else if(a < 0)
     {
-        pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
-        pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        pdcrt_objeto_debe_tener_uno_de_los_tipos(marco, rhs, PDCRT_TOBJ_ENTERO, PDCRT_TOBJ_FLOAT);
-        pdcrt_float flhs, frhs;
-        switch(yo.tag)
+        if((b > 0 && a < PDCRT_ENTERO_MIN / b) || (b < 0 && b < PDCRT_ENTERO_MAX / a))
+            return false;
+    }
+    *res = a * b;
+    return true;
+}
+
+static pdcrt_float pdcrt_operar_floats(pdcrt_float a, pdcrt_float b, enum pdcrt_operacion_aritmetica operacion)
+{
+    switch(operacion)
+    {
+    case PDCRT_SUMA:
+        return a + b;
+    case PDCRT_RESTA:
+        return a - b;
+    case PDCRT_MULTIPLICACION:
+        return a * b;
+    case PDCRT_DIVISION:
+        return a / b;
+    }
+    pdcrt_inalcanzable();
+}
+
+// Realiza `yo <operacion> rhs` sin enviar un mensaje. Si la operación entre
+// enteros se desbordaría el resultado se calcula como float. Devuelve `false`
+// si alguno de los operandos no es un número; en ese caso hay que enviar el
+// mensaje normalmente.
+static bool pdcrt_operar_numeros(pdcrt_objeto yo, pdcrt_objeto rhs, enum pdcrt_operacion_aritmetica operacion, PDCRT_OUT pdcrt_objeto* res)
+{
+    if(yo.tag == PDCRT_TOBJ_ENTERO && rhs.tag == PDCRT_TOBJ_ENTERO)
+    {
+        pdcrt_entero r;
+        bool ok;
+        switch(operacion)
         {
-        case PDCRT_TOBJ_ENTERO:
-            flhs = yo.value.i;
+        case PDCRT_SUMA:
+            ok = pdcrt_sumar_enteros(yo.value.i, rhs.value.i, &r);
             break;
-        case PDCRT_TOBJ_FLOAT:
-            flhs = yo.value.f;
-            break;
-        default:
-            pdcrt_inalcanzable();
-        }
-        switch(rhs.tag)
-        {
-        case PDCRT_TOBJ_ENTERO:
-            frhs = rhs.value.i;
+        case PDCRT_RESTA:
+            ok = pdcrt_restar_enteros(yo.value.i, rhs.value.i, &r);
             break;
-        case PDCRT_TOBJ_FLOAT:
-            frhs = rhs.value.f;
+        case PDCRT_MULTIPLICACION:
+            ok = pdcrt_multiplicar_enteros(yo.value.i, rhs.value.i, &r);
             break;
+        case PDCRT_DIVISION:
+            *res = pdcrt_objeto_float(((pdcrt_float) yo.value.i) / ((pdcrt_float) rhs.value.i));
+            return true;
         default:
             pdcrt_inalcanzable();
         }
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_float(flhs / frhs)));
+        if(ok)
+            *res = pdcrt_objeto_entero(r);
+        else
+            *res = pdcrt_objeto_float(pdcrt_operar_floats((pdcrt_float) yo.value.i, (pdcrt_float) rhs.value.i, operacion));
+        return true;
+    }
+
+    if(!pdcrt_es_numero(yo.tag) || !pdcrt_es_numero(rhs.tag))
+        return false;
+
+    pdcrt_float fyo = (yo.tag == PDCRT_TOBJ_ENTERO)? (pdcrt_float) yo.value.i : yo.value.f;
+    pdcrt_float frhs = (rhs.tag == PDCRT_TOBJ_ENTERO)? (pdcrt_float) rhs.value.i : rhs.value.f;
+    *res = pdcrt_objeto_float(pdcrt_operar_floats(fyo, frhs, operacion));
+    return true;
+}
+
+pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
+{
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
+    marco->nombre = u8"método de Numero";
+    pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
+
+#define PDCRT_NUMOP(operacion)                                          \
+    do                                                                  \
+    {                                                                   \
+        pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);      \
+        pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila); \
+        pdcrt_objeto_debe_tener_uno_de_los_tipos(marco, rhs, PDCRT_TOBJ_ENTERO, PDCRT_TOBJ_FLOAT); \
+        pdcrt_objeto res;                                               \
+        if(!pdcrt_operar_numeros(yo, rhs, operacion, &res))             \
+            pdcrt_inalcanzable();                                       \
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, res)); \
+    } while(0)
+
+    switch(msj.value.t->selector)
+    {
+    case PDCRT_SEL_operador_mas:
+    case PDCRT_SEL_msj_sumar:
+    {
+        PDCRT_NUMOP(PDCRT_SUMA);
+        pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
+        return pdcrt_continuacion_devolver();
+    }
+    case PDCRT_SEL_operador_menos:
+    case PDCRT_SEL_msj_restar:
+    {
+        PDCRT_NUMOP(PDCRT_RESTA);
+        pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
+        return pdcrt_continuacion_devolver();
+    }
+    case PDCRT_SEL_operador_por:
+    case PDCRT_SEL_msj_multiplicar:
+    {
+        PDCRT_NUMOP(PDCRT_MULTIPLICACION);
+        pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
+        return pdcrt_continuacion_devolver();
+    }
+    case PDCRT_SEL_operador_entre:
+    case PDCRT_SEL_msj_dividir:
+    {
+        PDCRT_NUMOP(PDCRT_DIVISION);
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_menorQue) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_menorQue))
+    case PDCRT_SEL_operador_menorQue:
+    case PDCRT_SEL_msj_menorQue:
     {
         pdcrt_comparar_numeros(marco, yo, args, rets, PDCRT_MENOR_QUE);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_mayorQue) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_mayorQue))
+    case PDCRT_SEL_operador_mayorQue:
+    case PDCRT_SEL_msj_mayorQue:
     {
         pdcrt_comparar_numeros(marco, yo, args, rets, PDCRT_MAYOR_QUE);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_menorOIgualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_menorOIgualA))
+    case PDCRT_SEL_operador_menorOIgualA:
+    case PDCRT_SEL_msj_menorOIgualA:
     {
         pdcrt_comparar_numeros(marco, yo, args, rets, PDCRT_MENOR_O_IGUAL_A);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_mayorOIgualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_mayorOIgualA))
+    case PDCRT_SEL_operador_mayorOIgualA:
+    case PDCRT_SEL_msj_mayorOIgualA:
     {
         pdcrt_comparar_numeros(marco, yo, args, rets, PDCRT_MAYOR_O_IGUAL_A);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoTexto))
+    case PDCRT_SEL_msj_comoTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
 #define PDCRT_LONGITUD_BUFFER 60
@@ -1752,7 +2163,7 @@ pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_mar
         return pdcrt_continuacion_devolver();
 #undef PDCRT_LONGITUD_BUFFER
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_negar))
+    case PDCRT_SEL_msj_negar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         switch(yo.tag)
@@ -1769,30 +2180,32 @@ pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_mar
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_clonar))
+    case PDCRT_SEL_msj_clonar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_igualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_igualA))
+    case PDCRT_SEL_msj_igualA:
+    case PDCRT_SEL_operador_igualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_distintoDe) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_noIgualA))
+    case PDCRT_SEL_msj_distintoDe:
+    case PDCRT_SEL_operador_noIgualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_truncar))
+    case PDCRT_SEL_msj_truncar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         pdcrt_entero r;
@@ -1811,7 +2224,7 @@ pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_mar
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_piso))
+    case PDCRT_SEL_msj_piso:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         pdcrt_float r;
@@ -1830,7 +2243,7 @@ pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_mar
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_techo))
+    case PDCRT_SEL_msj_techo:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         pdcrt_float r;
@@ -1849,7 +2262,7 @@ pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_mar
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoByteEnTexto))
+    case PDCRT_SEL_msj_comoByteEnTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         char c;
@@ -1869,18 +2282,16 @@ pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_mar
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_hashPara))
+    case PDCRT_SEL_msj_hashPara:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
-        pdcrt_objeto on = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        pdcrt_objeto_debe_tener_tipo(on, PDCRT_TOBJ_ENTERO);
-        pdcrt_uentero n = on.value.i;
+        pdcrt_uentero n = pdcrt_sacar_rango_de_hash(marco->contexto);
         pdcrt_entero hash = pdcrt_hashear_objeto(yo, n);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_entero(hash)));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else
+    default:
     {
         printf("Mensaje ");
         pdcrt_escribir_texto(msj.value.t);
@@ -1899,6 +2310,7 @@ pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_mar
         printf("\n");
         pdcrt_abort();
     }
+    }
 
     return pdcrt_continuacion_devolver();
 #undef PDCRT_NUMOP
@@ -1906,47 +2318,51 @@ pdcrt_continuacion pdcrt_recv_numero(struct pdcrt_marco* marco, struct pdcrt_mar
 
 pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de Texto";
     pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
-    if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_longitud))
+    switch(msj.value.t->selector)
+    {
+    case PDCRT_SEL_msj_longitud:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_entero(yo.value.t->longitud)));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoTexto))
+    case PDCRT_SEL_msj_comoTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_clonar))
+    case PDCRT_SEL_msj_clonar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_igualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_igualA))
+    case PDCRT_SEL_msj_igualA:
+    case PDCRT_SEL_operador_igualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_distintoDe) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_noIgualA))
+    case PDCRT_SEL_msj_distintoDe:
+    case PDCRT_SEL_operador_noIgualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoNumeroEntero))
+    case PDCRT_SEL_msj_comoNumeroEntero:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         char* buff = pdcrt_alojar_simple(marco->contexto->alojador, sizeof(char) * (yo.value.t->longitud + 1));
@@ -1971,7 +2387,7 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoNumeroReal))
+    case PDCRT_SEL_msj_comoNumeroReal:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         char* buff = pdcrt_alojar_simple(marco->contexto->alojador, sizeof(char) * (yo.value.t->longitud + 1));
@@ -2020,7 +2436,7 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_en))
+    case PDCRT_SEL_msj_en:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto obj = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2045,7 +2461,7 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_concatenar))
+    case PDCRT_SEL_msj_concatenar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto obj = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2062,7 +2478,7 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_parteDelTexto))
+    case PDCRT_SEL_msj_parteDelTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto ofinal = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2089,7 +2505,7 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_subTexto))
+    case PDCRT_SEL_msj_subTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto olon = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2113,7 +2529,7 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_buscar))
+    case PDCRT_SEL_msj_buscar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto otxt = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2164,14 +2580,14 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_buscarEnReversa))
+    case PDCRT_SEL_msj_buscarEnReversa:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_no_implementado("Texto#buscarEnReversa");
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_formatear))
+    case PDCRT_SEL_msj_formatear:
     {
         pdcrt_insertar_elemento_en_pila(&marco->contexto->pila, marco->contexto->alojador, args, yo);
         return pdcrt_continuacion_tail_enviar_mensaje(marco_superior,
@@ -2180,7 +2596,7 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
                                                       args + 1,
                                                       rets);
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_byteEn))
+    case PDCRT_SEL_msj_byteEn:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto obj = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2205,18 +2621,16 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_hashPara))
+    case PDCRT_SEL_msj_hashPara:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
-        pdcrt_objeto on = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        pdcrt_objeto_debe_tener_tipo(on, PDCRT_TOBJ_ENTERO);
-        pdcrt_uentero n = on.value.i;
+        pdcrt_uentero n = pdcrt_sacar_rango_de_hash(marco->contexto);
         pdcrt_entero hash = pdcrt_hashear_objeto(yo, n);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_entero(hash)));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else
+    default:
     {
         printf("Mensaje ");
         pdcrt_escribir_texto(msj.value.t);
@@ -2230,37 +2644,42 @@ pdcrt_continuacion pdcrt_recv_texto(struct pdcrt_marco* marco, struct pdcrt_marc
         printf("\n");
         pdcrt_abort();
     }
+    }
 
     return pdcrt_continuacion_devolver();
 }
 
 pdcrt_continuacion pdcrt_recv_closure(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de Procedimiento";
     pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
-    if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_llamar))
+    switch(msj.value.t->selector)
+    {
+    case PDCRT_SEL_msj_llamar:
     {
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
         return pdcrt_continuacion_tail_iniciar((pdcrt_proc_t) yo.value.c.proc, marco_superior, args + 1, rets);
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_igualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_igualA))
+    case PDCRT_SEL_msj_igualA:
+    case PDCRT_SEL_operador_igualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_distintoDe) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_noIgualA))
+    case PDCRT_SEL_msj_distintoDe:
+    case PDCRT_SEL_operador_noIgualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoObjeto))
+    case PDCRT_SEL_msj_comoObjeto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         yo.tag = PDCRT_TOBJ_OBJETO;
@@ -2269,7 +2688,7 @@ pdcrt_continuacion pdcrt_recv_closure(struct pdcrt_marco* marco, struct pdcrt_ma
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj___codigoIgualA))
+    case PDCRT_SEL_msj___codigoIgualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2278,7 +2697,7 @@ pdcrt_continuacion pdcrt_recv_closure(struct pdcrt_marco* marco, struct pdcrt_ma
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj___entornoIgualA))
+    case PDCRT_SEL_msj___entornoIgualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2287,14 +2706,14 @@ pdcrt_continuacion pdcrt_recv_closure(struct pdcrt_marco* marco, struct pdcrt_ma
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_clonar))
+    case PDCRT_SEL_msj_clonar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoTexto))
+    case PDCRT_SEL_msj_comoTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         char texto[128];
@@ -2308,7 +2727,7 @@ pdcrt_continuacion pdcrt_recv_closure(struct pdcrt_marco* marco, struct pdcrt_ma
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else
+    default:
     {
         printf("Mensaje ");
         pdcrt_escribir_texto(msj.value.t);
@@ -2319,6 +2738,7 @@ pdcrt_continuacion pdcrt_recv_closure(struct pdcrt_marco* marco, struct pdcrt_ma
                yo.value.c.env->env_size);
         pdcrt_abort();
     }
+    }
 
     return pdcrt_continuacion_devolver();
 }
@@ -2337,10 +2757,12 @@ pdcrt_continuacion pdcrt_recv_marca_de_pila(struct pdcrt_marco* marco, struct pd
 
 pdcrt_continuacion pdcrt_recv_booleano(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de Booleano";
     pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
-    if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoTexto))
+    switch(msj.value.t->selector)
+    {
+    case PDCRT_SEL_msj_comoTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         pdcrt_texto* texto = NULL;
@@ -2356,30 +2778,32 @@ pdcrt_continuacion pdcrt_recv_booleano(struct pdcrt_marco* marco, struct pdcrt_m
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_igualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_igualA))
+    case PDCRT_SEL_msj_igualA:
+    case PDCRT_SEL_operador_igualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_distintoDe) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_noIgualA))
+    case PDCRT_SEL_msj_distintoDe:
+    case PDCRT_SEL_operador_noIgualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_clonar))
+    case PDCRT_SEL_msj_clonar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_escojer))
+    case PDCRT_SEL_msj_escojer:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto a = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2389,7 +2813,7 @@ pdcrt_continuacion pdcrt_recv_booleano(struct pdcrt_marco* marco, struct pdcrt_m
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_llamarSegun))
+    case PDCRT_SEL_msj_llamarSegun:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto a = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2398,7 +2822,8 @@ pdcrt_continuacion pdcrt_recv_booleano(struct pdcrt_marco* marco, struct pdcrt_m
         pdcrt_objeto llamar_msj = pdcrt_objeto_desde_texto(marco->contexto->constantes.msj_llamar);
         return pdcrt_continuacion_tail_enviar_mensaje(marco_superior, res, llamar_msj, 0, rets);
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_y) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_y))
+    case PDCRT_SEL_msj_y:
+    case PDCRT_SEL_operador_y:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto otro = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2407,7 +2832,8 @@ pdcrt_continuacion pdcrt_recv_booleano(struct pdcrt_marco* marco, struct pdcrt_m
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_o) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_o))
+    case PDCRT_SEL_msj_o:
+    case PDCRT_SEL_operador_o:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto otro = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2416,33 +2842,34 @@ pdcrt_continuacion pdcrt_recv_booleano(struct pdcrt_marco* marco, struct pdcrt_m
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_hashPara))
+    case PDCRT_SEL_msj_hashPara:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
-        pdcrt_objeto on = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        pdcrt_objeto_debe_tener_tipo(on, PDCRT_TOBJ_ENTERO);
-        pdcrt_uentero n = on.value.i;
+        pdcrt_uentero n = pdcrt_sacar_rango_de_hash(marco->contexto);
         pdcrt_entero hash = pdcrt_hashear_objeto(yo, n);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_entero(hash)));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else
+    default:
     {
         printf("Mensaje ");
         pdcrt_escribir_texto(msj.value.t);
         printf(" no entendido para el booleano %s\n", yo.value.b? "VERDADERO" : "FALSO");
         pdcrt_abort();
     }
+    }
     return pdcrt_continuacion_devolver();
 }
 
 pdcrt_continuacion pdcrt_recv_nulo(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de TipoNulo";
     pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
-    if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoTexto))
+    switch(msj.value.t->selector)
+    {
+    case PDCRT_SEL_msj_comoTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila,
@@ -2451,53 +2878,54 @@ pdcrt_continuacion pdcrt_recv_nulo(struct pdcrt_marco* marco, struct pdcrt_marco
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_clonar))
+    case PDCRT_SEL_msj_clonar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_igualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_igualA))
+    case PDCRT_SEL_msj_igualA:
+    case PDCRT_SEL_operador_igualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_distintoDe) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_noIgualA))
+    case PDCRT_SEL_msj_distintoDe:
+    case PDCRT_SEL_operador_noIgualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto rhs = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_iguales(yo, rhs))));
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(!pdcrt_objeto_escalar_iguales(yo, rhs))));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_hashPara))
+    case PDCRT_SEL_msj_hashPara:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
-        pdcrt_objeto on = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        pdcrt_objeto_debe_tener_tipo(on, PDCRT_TOBJ_ENTERO);
-        pdcrt_uentero n = on.value.i;
+        pdcrt_uentero n = pdcrt_sacar_rango_de_hash(marco->contexto);
         pdcrt_entero hash = pdcrt_hashear_objeto(yo, n);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_entero(hash)));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else
+    default:
     {
         printf("Mensaje ");
         pdcrt_escribir_texto(msj.value.t);
         printf(" no entendido para NULO (instancia de TipoNulo)\n");
         pdcrt_abort();
     }
+    }
     return pdcrt_continuacion_devolver();
 }
 
 pdcrt_continuacion pdcrt_recv_objeto(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de Objeto";
     pdcrt_objeto_debe_tener_tipo_tb(marco, yo, PDCRT_TOBJ_OBJETO);
     pdcrt_insertar_elemento_en_pila(&marco->contexto->pila, marco->contexto->alojador, args, msj);
@@ -2507,19 +2935,22 @@ pdcrt_continuacion pdcrt_recv_objeto(struct pdcrt_marco* marco, struct pdcrt_mar
 
 pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de Arreglo";
     pdcrt_objeto_debe_tener_tipo_tb(marco, yo, PDCRT_TOBJ_ARREGLO);
     pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
-    if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_agregarAlFinal))
+    switch(msj.value.t->selector)
+    {
+    case PDCRT_SEL_msj_agregarAlFinal:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto el = pdcrt_sacar_de_pila(&marco->contexto->pila);
-        no_falla(pdcrt_arreglo_agregar_al_final(marco->contexto->alojador, yo.value.a, el));
+        no_falla(pdcrt_arreglo_agregar_al_final(marco->contexto->gc.alojador, yo.value.a, el));
+        pdcrt_gc_write_barrier_en_arreglo(marco->contexto, yo.value.a, yo.value.a->longitud - 1, el);
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_longitud))
+    case PDCRT_SEL_msj_longitud:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         // FIXME: Overflow
@@ -2527,7 +2958,7 @@ pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_ma
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoTexto))
+    case PDCRT_SEL_msj_comoTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
@@ -2537,7 +2968,7 @@ pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_ma
                                                       1,
                                                       rets);
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_en))
+    case PDCRT_SEL_msj_en:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto obj_indice = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2550,7 +2981,7 @@ pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_ma
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_fijarEn))
+    case PDCRT_SEL_msj_fijarEn:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto obj_valor = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2560,22 +2991,22 @@ pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_ma
         size_t indice = obj_indice.value.i;
         PDCRT_ASSERT(indice < yo.value.a->longitud);
         yo.value.a->elementos[indice] = obj_valor;
-        pdcrt_gc_write_barrier(marco->contexto, yo, obj_valor);
+        pdcrt_gc_write_barrier_en_arreglo(marco->contexto, yo.value.a, indice, obj_valor);
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_redimensionar))
+    case PDCRT_SEL_msj_redimensionar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto nueva_longitud_obj = pdcrt_sacar_de_pila(&marco->contexto->pila);
         pdcrt_objeto_debe_tener_tipo_tb(marco, nueva_longitud_obj, PDCRT_TOBJ_ENTERO);
         PDCRT_ASSERT(nueva_longitud_obj.value.i >= 0);
         size_t nueva_longitud = nueva_longitud_obj.value.i;
-        no_falla(pdcrt_arreglo_redimensionar(marco->contexto->alojador, yo.value.a, nueva_longitud));
+        no_falla(pdcrt_arreglo_redimensionar(marco->contexto->gc.alojador, yo.value.a, nueva_longitud));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_mapear))
+    case PDCRT_SEL_msj_mapear:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_insertar_elemento_en_pila(&marco->contexto->pila, marco->contexto->alojador, 1, yo);
@@ -2585,7 +3016,7 @@ pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_ma
                                                       2,
                                                       rets);
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_clonar))
+    case PDCRT_SEL_msj_clonar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, yo));
@@ -2595,7 +3026,8 @@ pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_ma
                                                       1,
                                                       rets);
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_igualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_igualA))
+    case PDCRT_SEL_msj_igualA:
+    case PDCRT_SEL_operador_igualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto otro = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2616,7 +3048,8 @@ pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_ma
                                                           rets);
         }
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_distintoDe) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_noIgualA))
+    case PDCRT_SEL_msj_distintoDe:
+    case PDCRT_SEL_operador_noIgualA:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto otro = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -2637,19 +3070,20 @@ pdcrt_continuacion pdcrt_recv_arreglo(struct pdcrt_marco* marco, struct pdcrt_ma
                                                           rets);
         }
     }
-    else
+    default:
     {
         printf("Mensaje ");
         pdcrt_escribir_texto(msj.value.t);
         printf(" no entendido para el arreglo\n");
         pdcrt_abort();
     }
+    }
     return pdcrt_continuacion_devolver();
 }
 
 pdcrt_continuacion pdcrt_recv_espacio_de_nombres(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de EspacioDeNombres";
     pdcrt_objeto_debe_tener_tipo_tb(marco, yo, PDCRT_TOBJ_ESPACIO_DE_NOMBRES);
     pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
@@ -2704,7 +3138,7 @@ pdcrt_continuacion pdcrt_recv_espacio_de_nombres(struct pdcrt_marco* marco, stru
 
 pdcrt_continuacion pdcrt_recv_voidptr(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de VoidPtr";
     (void) marco;
     (void) args;
@@ -2811,30 +3245,154 @@ void pdcrt_insertar_elemento_en_pila(pdcrt_pila* pila, pdcrt_alojador alojador,
 
 // Textos:
 
-pdcrt_error pdcrt_inic_textos(pdcrt_gc* gc, size_t cap, PDCRT_OUT pdcrt_textos* textos)
+// El número de ranuras de `pdcrt_textos.anterior` que se mueven a
+// `pdcrt_textos.actual` en cada inserción. Como la tabla nueva es al menos el
+// doble de grande, con 2 ya se terminaría de mover la tabla vieja antes de que
+// la nueva se llene.
+#define PDCRT_TEXTOS_A_MIGRAR_POR_INSERCION 8
+
+static pdcrt_error pdcrt_inic_tabla_de_textos(pdcrt_gc* gc, size_t cap, PDCRT_OUT pdcrt_tabla_de_textos* tabla)
 {
-    textos->longitud = 0;
-    textos->capacidad = cap;
-    textos->textos = NULL;
+    tabla->capacidad = cap;
+    tabla->ocupadas = 0;
+    tabla->ranuras = NULL;
     if(cap > 0)
     {
-        textos->textos = pdcrt_alojar_simple(gc->alojador, cap * sizeof(pdcrt_texto*));
-        if(!textos->textos)
-        {
+        tabla->ranuras = pdcrt_alojar_simple(gc->alojador, cap * sizeof(pdcrt_ranura_de_textos));
+        if(!tabla->ranuras)
             return PDCRT_ENOMEM;
+        memset(tabla->ranuras, 0, cap * sizeof(pdcrt_ranura_de_textos));
+    }
+    return PDCRT_OK;
+}
+
+static void pdcrt_deinic_tabla_de_textos(pdcrt_gc* gc, pdcrt_tabla_de_textos* tabla)
+{
+    if(tabla->ranuras)
+        pdcrt_dealojar_simple(gc->alojador, tabla->ranuras, tabla->capacidad * sizeof(pdcrt_ranura_de_textos));
+    tabla->ranuras = NULL;
+    tabla->capacidad = tabla->ocupadas = 0;
+}
+
+static PDCRT_NULL pdcrt_texto* pdcrt_tabla_de_textos_buscar(pdcrt_tabla_de_textos* tabla, uint64_t hash, const char* str, size_t len)
+{
+    if(tabla->capacidad == 0)
+        return NULL;
+    size_t mascara = tabla->capacidad - 1;
+    for(size_t i = hash & mascara;; i = (i + 1) & mascara)
+    {
+        pdcrt_ranura_de_textos* r = &tabla->ranuras[i];
+        if(!r->texto)
+        {
+            if(r->hash == 0)
+                return NULL;
+            continue;
+        }
+        if(r->hash == hash && r->texto->longitud == len && (len == 0 || memcmp(r->texto->contenido, str, len) == 0))
+            return r->texto;
+    }
+}
+
+// Inserta un texto que no está en la tabla. La tabla debe tener espacio.
+static void pdcrt_tabla_de_textos_insertar(pdcrt_tabla_de_textos* tabla, uint64_t hash, pdcrt_texto* texto)
+{
+    PDCRT_ASSERT(tabla->ocupadas < tabla->capacidad);
+    size_t mascara = tabla->capacidad - 1;
+    size_t i = hash & mascara;
+    while(tabla->ranuras[i].texto)
+        i = (i + 1) & mascara;
+    if(tabla->ranuras[i].hash == 0)
+        tabla->ocupadas += 1;
+    tabla->ranuras[i].hash = hash;
+    tabla->ranuras[i].texto = texto;
+}
+
+// Quita `texto` de la tabla si está en ella.
+static void pdcrt_tabla_de_textos_quitar(pdcrt_tabla_de_textos* tabla, pdcrt_texto* texto)
+{
+    if(tabla->capacidad == 0)
+        return;
+    size_t mascara = tabla->capacidad - 1;
+    for(size_t i = texto->hash & mascara;; i = (i + 1) & mascara)
+    {
+        pdcrt_ranura_de_textos* r = &tabla->ranuras[i];
+        if(r->texto == texto)
+        {
+            r->texto = NULL;
+            r->hash = PDCRT_RANURA_DE_TEXTOS_BORRADA;
+            return;
         }
+        if(!r->texto && r->hash == 0)
+            return;
+    }
+}
+
+// Mueve hasta `n` ranuras de la tabla anterior a la actual. Si ya no quedan
+// ranuras por mover desaloja la tabla anterior.
+static void pdcrt_textos_migrar(pdcrt_gc* gc, pdcrt_textos* textos, size_t n)
+{
+    pdcrt_tabla_de_textos* ant = &textos->anterior;
+    if(!ant->ranuras)
+        return;
+    for(; n > 0 && textos->migradas < ant->capacidad; n--, textos->migradas++)
+    {
+        pdcrt_ranura_de_textos* r = &ant->ranuras[textos->migradas];
+        if(r->texto)
+            pdcrt_tabla_de_textos_insertar(&textos->actual, r->hash, r->texto);
     }
-    for(size_t i = 0; i < cap; i++)
+    if(textos->migradas == ant->capacidad)
     {
-        textos->textos[i] = NULL;
+        pdcrt_deinic_tabla_de_textos(gc, ant);
+        textos->migradas = 0;
     }
+}
+
+static size_t pdcrt_textos_capacidad_para(size_t longitud)
+{
+    size_t cap = 64;
+    while(cap < 4 * (longitud + 1))
+        cap *= 2;
+    return cap;
+}
+
+// Reemplaza la tabla actual por una con espacio para al menos el doble de
+// los textos que hay ahora. La tabla actual se vuelve la anterior.
+static pdcrt_error pdcrt_textos_crecer(pdcrt_gc* gc, pdcrt_textos* textos)
+{
+    // Solo puede haber una tabla anterior a la vez.
+    pdcrt_textos_migrar(gc, textos, SIZE_MAX);
+    size_t cap = pdcrt_textos_capacidad_para(textos->longitud);
+    pdcrt_tabla_de_textos nueva;
+    pdcrt_error err = pdcrt_inic_tabla_de_textos(gc, cap, &nueva);
+    if(err != PDCRT_OK)
+        return err;
+    textos->anterior = textos->actual;
+    textos->actual = nueva;
+    textos->migradas = 0;
     return PDCRT_OK;
 }
 
+pdcrt_error pdcrt_inic_textos(pdcrt_gc* gc, size_t cap, PDCRT_OUT pdcrt_textos* textos)
+{
+    size_t cap_real = 64;
+    while(cap_real < 2 * cap)
+        cap_real *= 2;
+    textos->longitud = 0;
+    textos->migradas = 0;
+    textos->nuevos = NULL;
+    textos->num_nuevos = textos->capacidad_nuevos = 0;
+    pdcrt_inic_tabla_de_textos(gc, 0, &textos->anterior);
+    return pdcrt_inic_tabla_de_textos(gc, cap_real, &textos->actual);
+}
+
 void pdcrt_deinic_textos(pdcrt_gc* gc, pdcrt_textos* textos)
 {
-    if(textos->textos)
-        pdcrt_dealojar_simple(gc->alojador, textos->textos, textos->capacidad * sizeof(pdcrt_texto*));
+    pdcrt_deinic_tabla_de_textos(gc, &textos->actual);
+    pdcrt_deinic_tabla_de_textos(gc, &textos->anterior);
+    if(textos->nuevos)
+        pdcrt_dealojar_simple(gc->alojador, textos->nuevos, textos->capacidad_nuevos * sizeof(pdcrt_texto*));
+    textos->nuevos = NULL;
+    textos->num_nuevos = textos->capacidad_nuevos = 0;
 }
 
 pdcrt_error pdcrt_textos_obtener_cstr(pdcrt_gc* gc,
@@ -2851,61 +3409,44 @@ pdcrt_error pdcrt_textos_obtener_lstr(pdcrt_gc* gc,
                                       size_t len,
                                       PDCRT_OUT pdcrt_texto** texto)
 {
-    size_t t = textos->longitud;
-    size_t b = 0;
-    while(b < t)
+    uint64_t hash = pdcrt_hash_de_contenido(str, len);
+
+    pdcrt_texto* txt = pdcrt_tabla_de_textos_buscar(&textos->actual, hash, str, len);
+    if(!txt)
+        txt = pdcrt_tabla_de_textos_buscar(&textos->anterior, hash, str, len);
+    if(txt)
     {
-        size_t p = (t - b) / 2 + b;
-        pdcrt_texto* txt = textos->textos[p];
-        int c = pdcrt_texto_comparar(txt, str, len);
-        if(c == 0)
-        {
-            *texto = txt;
-            return PDCRT_OK;
-        }
-        else if(c < 0)
-        {
-            t = p;
-        }
-        else
-        {
-            b = p + 1;
-        }
+        *texto = txt;
+        return PDCRT_OK;
     }
 
-    PDCRT_ASSERT(t == b);
-    if(textos->longitud >= textos->capacidad)
+    // La tabla nunca se llena a más de la mitad.
+    if(2 * (textos->actual.ocupadas + 1) > textos->actual.capacidad)
     {
-        size_t oc = textos->capacidad;
-        textos->capacidad = pdcrt_siguiente_capacidad(textos->capacidad, textos->longitud, 1);
-        pdcrt_texto** nt = pdcrt_realojar_simple(gc->alojador,
-                                                 textos->textos,
-                                                 oc * sizeof(pdcrt_texto*),
-                                                 textos->capacidad * sizeof(pdcrt_texto*));
-        if(!nt)
-        {
-            textos->capacidad = oc;
+        pdcrt_error err = pdcrt_textos_crecer(gc, textos);
+        if(err != PDCRT_OK)
+            return err;
+    }
+    if(textos->num_nuevos == textos->capacidad_nuevos)
+    {
+        size_t cap = textos->capacidad_nuevos == 0 ? 64 : 2 * textos->capacidad_nuevos;
+        pdcrt_texto** nuevos = pdcrt_realojar_simple(gc->alojador, textos->nuevos, textos->capacidad_nuevos * sizeof(pdcrt_texto*), cap * sizeof(pdcrt_texto*));
+        if(!nuevos)
             return PDCRT_ENOMEM;
-        }
-        textos->textos = nt;
+        textos->nuevos = nuevos;
+        textos->capacidad_nuevos = cap;
     }
-    pdcrt_texto* txt;
     pdcrt_error err = pdcrt_aloj_texto(&txt, gc, len);
     if(err != PDCRT_OK)
         return err;
     if(len > 0)
         memcpy(txt->contenido, str, len);
+    txt->hash = hash;
 
-    PDCRT_ASSERT(textos->longitud < textos->capacidad);
-    if(textos->longitud > 0)
-    {
-        for(size_t i = textos->longitud; i > t; i--)
-        {
-            textos->textos[i] = textos->textos[i - 1];
-        }
-    }
-    textos->textos[t] = txt;
+    pdcrt_tabla_de_textos_insertar(&textos->actual, hash, txt);
     textos->longitud += 1;
+    textos->nuevos[textos->num_nuevos++] = txt;
+    pdcrt_textos_migrar(gc, textos, PDCRT_TEXTOS_A_MIGRAR_POR_INSERCION);
     *texto = txt;
 
     return PDCRT_OK;
@@ -2928,94 +3469,14 @@ pdcrt_texto* pdcrt_obtener_texto_txt(pdcrt_gc* gc, pdcrt_textos* txt, const char
 
 // Constantes:
 
-#define PDCRT_TABLA_DE_TEXTOS(M)                                        \
-    M(operador_mas, "operador_+");                                      \
-    M(operador_menos, "operador_-");                                    \
-    M(operador_por, "operador_*");                                      \
-    M(operador_entre, "operador_/");                                    \
-    M(operador_menorQue, "operador_<");                                 \
-    M(operador_menorOIgualA, "operador_=<");                            \
-    M(operador_mayorQue, "operador_>");                                 \
-    M(operador_mayorOIgualA, "operador_>=");                            \
-    M(operador_igualA, "operador_=");                                   \
-    M(operador_noIgualA, "operador_no=");                               \
-    M(operador_y, "operador_&&");                                       \
-    M(operador_o, "operador_||");                                       \
-    M(msj_sumar, "sumar");                                              \
-    M(msj_restar, "restar");                                            \
-    M(msj_multiplicar, "multiplicar");                                  \
-    M(msj_dividir, "dividir");                                          \
-    M(msj_menorQue, "menorQue");                                        \
-    M(msj_mayorQue, "mayorQue");                                        \
-    M(msj_menorOIgualA, "menorOIgualA");                                \
-    M(msj_mayorOIgualA, "mayorOIgualA");                                \
-    M(msj_igualA, "igualA");                                            \
-    M(msj_distintoDe, u8"distíntoDe");                                  \
-    M(msj_clonar, "clonar");                                            \
-    M(msj_llamar, "llamar");                                            \
-    M(msj_comoTexto, "comoTexto");                                      \
-    M(msj_negar, "negar");                                              \
-    M(msj_truncar, "truncar");                                          \
-    M(msj_piso, "piso");                                                \
-    M(msj_techo, "techo");                                              \
-    M(msj_comoByteEnTexto, "comoByteEnTexto");                          \
-    M(msj_hashPara, "hashPara");                                        \
-    M(msj_longitud, "longitud");                                        \
-    M(msj_comoNumeroEntero, "comoNumeroEntero");                        \
-    M(msj_comoNumeroReal, "comoNumeroReal");                            \
-    M(msj_en, "en");                                                    \
-    M(msj_fijarEn, "fijarEn");                                          \
-    M(msj_concatenar, "concatenar");                                    \
-    M(msj_parteDelTexto, "parteDelTexto");                              \
-    M(msj_subTexto, "subTexto");                                        \
-    M(msj_buscar, "buscar");                                            \
-    M(msj_buscarEnReversa, "buscarEnReversa");                          \
-    M(msj_formatear, "formatear");                                      \
-    M(msj_byteEn, "byteEn");                                            \
-    M(msj_comoObjeto, "comoObjeto");                                    \
-    M(msj___codigoIgualA, u8"__códigoIgualA");                          \
-    M(msj___entornoIgualA, "__entornoIgualA");                          \
-    M(msj_escojer, "escojer");                                          \
-    M(msj_llamarSegun, "llamarSegun");                                  \
-    M(msj_y, "y");                                                      \
-    M(msj_o, "o");                                                      \
-    M(msj_agregarAlFinal, "agregarAlFinal");                            \
-    M(msj_redimensionar, "redimensionar");                              \
-    M(msj_entornoBootstrap, "entornoBootstrap");                        \
-    M(msj_fijar_entornoBootstrap, "fijar_entornoBootstrap");            \
-    M(msj_leerCaracter, "leerCaracter");                                \
-    M(msj_abrirArchivo, "abrirArchivo");                                \
-    M(msj_construirTexto, "construirTexto");                            \
-    M(msj_estaAbierto, "estaAbierto");                                  \
-    M(msj_leerByte, "leerByte");                                        \
-    M(msj_cerrar, "cerrar");                                            \
-    M(msj_obtenerSiguienteByte, "obtenerSiguienteByte");                \
-    M(msj_escribirByte, "escribirByte");                                \
-    M(msj_escribirTexto, "escribirTexto");                              \
-    M(msj_posicionActual, "posicionActual");                            \
-    M(msj_cambiarPosicion, "cambiarPosicion");                          \
-    M(msj_finDelArchivo, "finDelArchivo");                              \
-    M(msj_error, "error");                                              \
-    M(msj_nombreDelArchivo, "nombreDelArchivo");                        \
-    M(msj_modo, "modo");                                                \
-    M(msj___leerTodo, "__leerTodo");                                    \
-    M(msj_mapear, "mapear");                                            \
-    M(msj_reducir, "reducir");                                          \
-    M(msj_argc, "argc");                                                \
-    M(msj_argv, "argv");                                                \
-    M(msj_fallarConMensaje, "fallarConMensaje");                        \
-    M(msj_objeto, "objeto");                                            \
-    M(msj_fijar_objeto, "fijar_objeto");                                \
-    M(txt_verdadero, "VERDADERO");                                      \
-    M(txt_falso, "FALSO");                                              \
-    M(txt_nulo, "NULO");
-
 pdcrt_error pdcrt_aloj_constantes(pdcrt_gc* gc, pdcrt_textos* textos, PDCRT_OUT pdcrt_constantes* consts)
 {
     consts->textos = NULL;
     consts->num_textos = 0;
 
-#define PDCRT_INIC_TEXTO(cm, lit) consts->cm = pdcrt_obtener_texto_txt(gc, textos, lit, sizeof(lit) - 1);
+#define PDCRT_INIC_TEXTO(cm, lit)                                       \
+    consts->cm = pdcrt_obtener_texto_txt(gc, textos, lit, sizeof(lit) - 1); \
+    consts->cm->selector = PDCRT_SEL_##cm;
 #define PDCRT_NULL_CONST_TXT(cm, _lit) consts->cm = NULL;
 
     PDCRT_TABLA_DE_TEXTOS(PDCRT_NULL_CONST_TXT)
@@ -3049,7 +3510,11 @@ pdcrt_error pdcrt_registrar_constante_textual(pdcrt_gc* gc, pdcrt_constantes* co
             PDCRT_ESCRIBIR_ERROR(PDCRT_ENOMEM, __func__);
             return PDCRT_ENOMEM;
         }
-        consts->num_textos += 1;
+        for(size_t i = consts->num_textos; i < idx; i++)
+        {
+            consts->textos[i] = NULL;
+        }
+        consts->num_textos = nuevo_tam;
         consts->textos[idx] = texto;
     }
     return PDCRT_OK;
@@ -3140,33 +3605,67 @@ PDCRT_NULL void* pdcrt_realojar(pdcrt_contexto* ctx, void* ptr, size_t tam_actua
 
 // Contexto:
 
+// PDCRT_TAM_PILA_DE_LOCALES es el número de locales (`pdcrt_objeto`s) que
+// caben en la pila de locales de cada contexto.
+#define PDCRT_TAM_PILA_DE_LOCALES 16384
+
+static pdcrt_error pdcrt_inic_pila_de_locales(pdcrt_pila_de_locales* pila, pdcrt_alojador alojador)
+{
+    pila->tope = 0;
+    pila->capacidad = PDCRT_TAM_PILA_DE_LOCALES;
+    pila->elementos = pdcrt_alojar_simple(alojador, sizeof(pdcrt_objeto) * pila->capacidad);
+    if(!pila->elementos)
+    {
+        pila->capacidad = 0;
+        PDCRT_ESCRIBIR_ERROR(PDCRT_ENOMEM, __func__);
+        return PDCRT_ENOMEM;
+    }
+    return PDCRT_OK;
+}
+
+static void pdcrt_deinic_pila_de_locales(pdcrt_pila_de_locales* pila, pdcrt_alojador alojador)
+{
+    PDCRT_ASSERT(pila->tope == 0);
+    pdcrt_dealojar_simple(alojador, pila->elementos, sizeof(pdcrt_objeto) * pila->capacidad);
+    pila->elementos = NULL;
+    pila->capacidad = 0;
+}
+
 pdcrt_error pdcrt_inic_contexto(pdcrt_contexto* ctx, pdcrt_alojador alojador, size_t num_mods)
 {
     ctx->argc = 0;
     ctx->argv = NULL;
     ctx->claseObjeto = pdcrt_objeto_nulo();
     ctx->entornoBootstrap = pdcrt_objeto_nulo();
-    ctx->generacionDelRecolector = 1;
+    ctx->limite_de_recursion = PDCRT_OPT_LIMITE_DE_RECURSION;
     pdcrt_error pderrno;
     if((pderrno = pdcrt_inic_pila(&ctx->pila, alojador)) != PDCRT_OK)
     {
         return pderrno;
     }
     ctx->alojador = alojador;
+    if((pderrno = pdcrt_inic_pila_de_locales(&ctx->locales, alojador)) != PDCRT_OK)
+    {
+        pdcrt_deinic_pila(&ctx->pila, alojador);
+        return pderrno;
+    }
     if((pderrno = pdcrt_aloj_registro_de_modulos(alojador, &ctx->registro, num_mods)) != PDCRT_OK)
     {
         pdcrt_deinic_pila(&ctx->pila, alojador);
+        pdcrt_deinic_pila_de_locales(&ctx->locales, alojador);
         return pderrno;
     }
     if((pderrno = pdcrt_inic_gc(&ctx->gc, alojador)) != PDCRT_OK)
     {
         pdcrt_deinic_pila(&ctx->pila, alojador);
+        pdcrt_deinic_pila_de_locales(&ctx->locales, alojador);
         pdcrt_dealoj_registro_de_modulos(alojador, &ctx->registro);
         return pderrno;
     }
     if((pderrno = pdcrt_inic_textos(&ctx->gc, 500, &ctx->textos)) != PDCRT_OK)
     {
         pdcrt_deinic_pila(&ctx->pila, alojador);
+        pdcrt_deinic_pila_de_locales(&ctx->locales, alojador);
         pdcrt_deinic_gc(&ctx->gc);
         pdcrt_dealoj_registro_de_modulos(alojador, &ctx->registro);
         return pderrno;
@@ -3174,6 +3673,7 @@ pdcrt_error pdcrt_inic_contexto(pdcrt_contexto* ctx, pdcrt_alojador alojador, si
     if((pderrno = pdcrt_aloj_constantes(&ctx->gc, &ctx->textos, &ctx->constantes)) != PDCRT_OK)
     {
         pdcrt_deinic_pila(&ctx->pila, alojador);
+        pdcrt_deinic_pila_de_locales(&ctx->locales, alojador);
         pdcrt_deinic_gc(&ctx->gc);
         pdcrt_dealoj_registro_de_modulos(alojador, &ctx->registro);
         pdcrt_deinic_textos(&ctx->gc, &ctx->textos);
@@ -3182,10 +3682,17 @@ pdcrt_error pdcrt_inic_contexto(pdcrt_contexto* ctx, pdcrt_alojador alojador, si
     return PDCRT_OK;
 }
 
+static void pdcrt_invalidar_caches(void);
+
 void pdcrt_deinic_contexto(pdcrt_contexto* ctx, pdcrt_alojador alojador)
 {
     PDCRT_DEPURAR_CONTEXTO(ctx, "Deinicializando el contexto");
+#ifdef PDCRT_DBG_ESTADISTICAS_DE_LAS_CACHES
+    pdcrt_escribir_estadisticas_de_las_caches(stdout);
+#endif
+    pdcrt_invalidar_caches();
     pdcrt_deinic_pila(&ctx->pila, alojador);
+    pdcrt_deinic_pila_de_locales(&ctx->locales, alojador);
     pdcrt_deinic_textos(&ctx->gc, &ctx->textos);
     pdcrt_dealoj_constantes_internas(&ctx->gc, &ctx->constantes);
     pdcrt_deinic_gc(&ctx->gc);
@@ -3300,6 +3807,8 @@ void pdcrt_procesar_cli(pdcrt_contexto* ctx, int argc, char* argv[])
     ctx->argc = argc - 1;
     ctx->argv = argv + 1;
 
+    pdcrt_gc_configurar_desde_el_entorno(&ctx->gc);
+
     return;
 
     static bool check = false;
@@ -3350,17 +3859,29 @@ void pdcrt_agregar_modulo_al_contexto(pdcrt_contexto* ctx, size_t i, int const_n
 pdcrt_error pdcrt_inic_marco(pdcrt_marco* marco, pdcrt_contexto* contexto, size_t num_locales, PDCRT_NULL pdcrt_marco* marco_anterior, int num_valores_a_devolver)
 {
     size_t num_real_de_locales = num_locales + PDCRT_NUM_LOCALES_ESP;
-    marco->locales = pdcrt_alojar(contexto, sizeof(pdcrt_objeto) * num_real_de_locales);
-    if(!marco->locales)
+    pdcrt_pila_de_locales* pila = &contexto->locales;
+    if(pila->capacidad - pila->tope >= num_real_de_locales)
     {
-        PDCRT_ESCRIBIR_ERROR(PDCRT_ENOMEM, "pdcrt_inic_marco: alojando las locales");
-        return PDCRT_ENOMEM;
+        marco->locales = &pila->elementos[pila->tope];
+        marco->locales_en_la_pila = true;
+        pila->tope += num_real_de_locales;
+    }
+    else
+    {
+        marco->locales = pdcrt_alojar(contexto, sizeof(pdcrt_objeto) * num_real_de_locales);
+        marco->locales_en_la_pila = false;
+        if(!marco->locales)
+        {
+            PDCRT_ESCRIBIR_ERROR(PDCRT_ENOMEM, "pdcrt_inic_marco: alojando las locales");
+            return PDCRT_ENOMEM;
+        }
     }
     marco->esta_vivo = true;
     marco->contexto = contexto;
     marco->nombre = NULL;
     marco->marco_anterior = marco_anterior;
     marco->num_valores_a_devolver = num_valores_a_devolver;
+    marco->ciclo_gc = 0;
     marco->num_locales = num_real_de_locales;
     for(size_t i = 0; i < marco->num_locales; i++)
     {
@@ -3369,10 +3890,35 @@ pdcrt_error pdcrt_inic_marco(pdcrt_marco* marco, pdcrt_contexto* contexto, size_
     return PDCRT_OK;
 }
 
+void pdcrt_inic_marco_nativo(pdcrt_marco* marco, pdcrt_contexto* contexto, PDCRT_NULL pdcrt_marco* marco_anterior, int num_valores_a_devolver)
+{
+    marco->esta_vivo = true;
+    marco->contexto = contexto;
+    marco->nombre = NULL;
+    marco->marco_anterior = marco_anterior;
+    marco->num_valores_a_devolver = num_valores_a_devolver;
+    marco->ciclo_gc = 0;
+    marco->locales = NULL;
+    marco->num_locales = 0;
+    marco->locales_en_la_pila = false;
+}
+
 void pdcrt_deinic_marco(pdcrt_marco* marco)
 {
     PDCRT_DEPURAR_CONTEXTO(marco->contexto, "Deinicializando un marco");
-    pdcrt_dealojar(marco->contexto, marco->locales, sizeof(pdcrt_objeto) * marco->num_locales);
+    if(marco->locales_en_la_pila)
+    {
+        pdcrt_pila_de_locales* pila = &marco->contexto->locales;
+        PDCRT_ASSERT(marco->locales + marco->num_locales == &pila->elementos[pila->tope]);
+        pila->tope -= marco->num_locales;
+        marco->locales = NULL;
+        marco->locales_en_la_pila = false;
+    }
+    else if(marco->locales)
+    {
+        pdcrt_dealojar(marco->contexto, marco->locales, sizeof(pdcrt_objeto) * marco->num_locales);
+        marco->locales = NULL;
+    }
     marco->num_locales = 0;
     marco->esta_vivo = false;
 }
@@ -3444,508 +3990,1818 @@ void pdcrt_marco_fijar_nombre(pdcrt_marco* marco, const char* nombre)
 // Recolector de basura:
 
 
-void pdcrt_agregar_a_la_lista(pdcrt_lista_de_objetos* lista, pdcrt_cabecera_gc* obj)
+// Las clases de tamaño del montículo. Los textos, los espacios de nombres y
+// los arreglos tienen un tamaño fijo, así que cada uno tiene una sola clase
+// (en el mismo orden que `pdcrt_tipo_objeto_gc`). Los entornos se agrupan
+// según su número de variables.
+#define PDCRT_GC_TAM_ENV(n) (sizeof(pdcrt_env) + sizeof(pdcrt_objeto) * (n))
+#define PDCRT_GC_PRIMERA_CLASE_DE_ENV 3
+static const struct
+{
+    pdcrt_tipo_objeto_gc tipo;
+    size_t tam;
+} pdcrt_clases_gc[PDCRT_GC_NUM_CLASES] = {
+    { PDCRT_GC_TEXTO, sizeof(pdcrt_texto) },
+    { PDCRT_GC_ESPACIO_DE_NOMBRES, sizeof(pdcrt_espacio_de_nombres) },
+    { PDCRT_GC_ARREGLO, sizeof(pdcrt_arreglo) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(0) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(1) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(2) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(3) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(4) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(6) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(8) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(12) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(16) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(24) },
+    { PDCRT_GC_ENV, PDCRT_GC_TAM_ENV(32) },
+};
+
+static unsigned int pdcrt_gc_clase_de(size_t sz, pdcrt_tipo_objeto_gc tipo)
 {
-    if(!lista->ultimo)
+    if(tipo != PDCRT_GC_ENV)
     {
-        // Está vacía
-        PDCRT_ASSERT(!lista->primero);
-        lista->primero = obj;
-        lista->ultimo = obj;
-        obj->siguiente = NULL;
-        obj->anterior = NULL;
+        PDCRT_ASSERT(pdcrt_clases_gc[tipo].tipo == tipo && pdcrt_clases_gc[tipo].tam == sz);
+        return tipo;
     }
-    else
+    for(unsigned int i = PDCRT_GC_PRIMERA_CLASE_DE_ENV; i < PDCRT_GC_NUM_CLASES; i++)
     {
-        PDCRT_ASSERT(lista->ultimo->siguiente == NULL);
-        obj->anterior = lista->ultimo;
-        obj->anterior->siguiente = obj;
-        obj->siguiente = NULL;
-        lista->ultimo = obj;
+        if(pdcrt_clases_gc[i].tam >= sz)
+            return i;
     }
+    return PDCRT_GC_CLASE_GRANDE;
 }
 
-void pdcrt_eliminar_de_la_lista(pdcrt_lista_de_objetos* lista, pdcrt_cabecera_gc* obj)
+static size_t pdcrt_gc_tam_ranura(size_t tam)
 {
-    if(lista->primero == obj)
-        lista->primero = obj->siguiente;
-    if(lista->ultimo == obj)
-        lista->ultimo = obj->anterior;
-    if(obj->siguiente)
-        obj->siguiente->anterior = NULL;
-    if(obj->anterior)
-        obj->anterior->siguiente = NULL;
-    obj->siguiente = NULL;
-    obj->anterior = NULL;
+    size_t alineamiento = _Alignof(max_align_t);
+    tam = (tam + alineamiento - 1) / alineamiento * alineamiento;
+    return tam < PDCRT_GC_TAM_MIN_RANURA ? PDCRT_GC_TAM_MIN_RANURA : tam;
 }
 
-
-static size_t pdcrt_tam_de_objeto_de_tipo(pdcrt_tipo_objeto_gc tipo)
+// El índice del primer bit encendido de `x` (que no debe ser 0).
+static unsigned int pdcrt_primer_bit(uint64_t x)
 {
-    switch(tipo)
+#ifdef PDCRT_OPT_GNU
+    return __builtin_ctzll(x);
+#else
+    unsigned int i = 0;
+    while(!(x & 1))
     {
-    case PDCRT_GC_TEXTO:
-        return sizeof(pdcrt_texto);
-    case PDCRT_GC_ESPACIO_DE_NOMBRES:
-        return sizeof(pdcrt_espacio_de_nombres);
-    case PDCRT_GC_ARREGLO:
-        return sizeof(pdcrt_arreglo);
-    case PDCRT_GC_ENV:
-        return sizeof(pdcrt_env);
-    default:
-        pdcrt_inalcanzable();
+        x >>= 1;
+        i += 1;
     }
+    return i;
+#endif
 }
 
-size_t pdcrt_tam_de_objeto(pdcrt_cabecera_gc* obj)
+#ifdef PDCRT_OPT_GNU
+#define PDCRT_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define PDCRT_PREFETCH(ptr) ((void) (ptr))
+#endif
+
+static size_t pdcrt_contar_bits(uint64_t x)
 {
-    return pdcrt_tam_de_objeto_de_tipo(obj->tipo);
+#ifdef PDCRT_OPT_GNU
+    return __builtin_popcountll(x);
+#else
+    size_t n = 0;
+    for(; x; x &= x - 1)
+        n += 1;
+    return n;
+#endif
 }
 
-static void* pdcrt_alojador_de_gc_impl(void* datos_del_usuario, void* ptr, size_t tam_viejo, size_t tam_nuevo)
+// Los bits de la palabra `w` de los mapas de `pag` que corresponden a
+// ranuras existentes.
+static uint64_t pdcrt_gc_mascara(pdcrt_pagina_gc* pag, size_t w)
 {
-    pdcrt_gc* gc = datos_del_usuario;
-    gc->usado -= tam_viejo;
-    gc->usado += tam_nuevo;
-    return (*gc->alojador_original.alojar)(gc->alojador_original.datos, ptr, tam_viejo, tam_nuevo);
+    size_t inicio = w * 64;
+    if(inicio >= pag->num_ranuras)
+        return 0;
+    size_t n = pag->num_ranuras - inicio;
+    return n >= 64 ? UINT64_MAX : ((UINT64_C(1) << n) - 1);
 }
 
-static pdcrt_alojador pdcrt_alojador_de_gc(pdcrt_gc* gc)
+static pdcrt_cabecera_gc* pdcrt_gc_objeto_en(pdcrt_pagina_gc* pag, size_t ranura)
 {
-    return (pdcrt_alojador){ .alojar = &pdcrt_alojador_de_gc_impl, .datos = gc };
+    return (pdcrt_cabecera_gc*) &pag->ranuras[ranura * pag->tam_ranura];
 }
 
-pdcrt_error pdcrt_inic_gc(PDCRT_OUT pdcrt_gc* gc, pdcrt_alojador aloj)
+static bool pdcrt_gc_en_vivero(pdcrt_cabecera_gc* obj)
 {
-    gc->alojador_original = aloj;
-    gc->objetos_jovenes = (pdcrt_lista_de_objetos) {NULL, NULL};
-    gc->objetos_viejos = (pdcrt_lista_de_objetos) {NULL, NULL};
-    gc->objetos_viejos_que_contienen_a_uno_joven = (pdcrt_lista_de_objetos) {NULL, NULL};
-    gc->usado = 0;
-    gc->num_objetos = 0;
-    gc->alojador = pdcrt_alojador_de_gc(gc);
-    gc->cnt = 0;
-    gc->mcnt = 0;
-    return PDCRT_OK;
+    return obj->pagina == PDCRT_GC_PAGINA_DEL_VIVERO;
 }
 
-void pdcrt_deinic_gc(pdcrt_gc* gc)
+static pdcrt_pagina_gc* pdcrt_gc_pagina_de(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
 {
-    for(pdcrt_cabecera_gc* obj = gc->objetos_jovenes.primero; obj != NULL;)
-    {
-        pdcrt_cabecera_gc* sig = obj->siguiente;
-        pdcrt_gc_dealojar(gc, obj);
-        obj = sig;
-    }
-    for(pdcrt_cabecera_gc* obj = gc->objetos_viejos.primero; obj != NULL;)
-    {
-        pdcrt_cabecera_gc* sig = obj->siguiente;
-        pdcrt_gc_dealojar(gc, obj);
-        obj = sig;
-    }
+    PDCRT_ASSERT(!pdcrt_gc_en_vivero(obj));
+    return gc->paginas[obj->pagina];
 }
 
-pdcrt_cabecera_gc* pdcrt_gc_alojar(pdcrt_gc* gc, size_t sz, pdcrt_tipo_objeto_gc tipo)
+static bool pdcrt_gc_es_joven(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
 {
-    pdcrt_cabecera_gc* obj = pdcrt_alojar_simple(gc->alojador, sz);
-    if(!obj)
-        return NULL;
-    obj->joven = true;
-    obj->tipo = tipo;
-    obj->generacion = 0;
-    obj->anterior = NULL;
-    obj->siguiente = NULL;
-    pdcrt_agregar_a_la_lista(&gc->objetos_jovenes, obj);
-    gc->num_objetos += 1;
-    return obj;
+    if(pdcrt_gc_en_vivero(obj))
+        return true;
+    pdcrt_pagina_gc* pag = pdcrt_gc_pagina_de(gc, obj);
+    return pag->jovenes[obj->ranura / 64] & (UINT64_C(1) << (obj->ranura % 64));
 }
 
-void pdcrt_gc_olvidar(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
+static bool pdcrt_gc_esta_marcado(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
 {
-    pdcrt_eliminar_de_la_lista(&gc->objetos_jovenes, obj);
-    pdcrt_eliminar_de_la_lista(&gc->objetos_viejos, obj);
-    pdcrt_eliminar_de_la_lista(&gc->objetos_viejos_que_contienen_a_uno_joven, obj);
-    gc->num_objetos -= 1;
+    pdcrt_pagina_gc* pag = pdcrt_gc_pagina_de(gc, obj);
+    return pag->marcadas[obj->ranura / 64] & (UINT64_C(1) << (obj->ranura % 64));
 }
 
-static pdcrt_cabecera_gc* pdcrt_cabecera_de_objeto(pdcrt_objeto obj)
+// Marca a `obj`. Devuelve false si ya estaba marcado.
+static bool pdcrt_gc_marcar(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
 {
-    switch(obj.tag)
-    {
-    case PDCRT_TOBJ_TEXTO:
-        return (pdcrt_cabecera_gc*) obj.value.t;
-    case PDCRT_TOBJ_CLOSURE:
-    case PDCRT_TOBJ_OBJETO:
-        return (pdcrt_cabecera_gc*) obj.value.c.env;
-    case PDCRT_TOBJ_ARREGLO:
-        return (pdcrt_cabecera_gc*) obj.value.a;
-    case PDCRT_TOBJ_ESPACIO_DE_NOMBRES:
-        return (pdcrt_cabecera_gc*) obj.value.e;
-    default:
+    pdcrt_pagina_gc* pag = pdcrt_gc_pagina_de(gc, obj);
+    uint64_t bit = UINT64_C(1) << (obj->ranura % 64);
+    uint64_t* palabra = &pag->marcadas[obj->ranura / 64];
+    if(*palabra & bit)
+        return false;
+    *palabra |= bit;
+    return true;
+}
+
+// Las páginas se alojan con el alojador original para que no cuenten en
+// `alojados`: ahí solo cuentan las ranuras que se ocupan (ver
+// `pdcrt_gc_alojar`). Sí cuentan en `usado`.
+static pdcrt_pagina_gc* pdcrt_gc_aloj_pagina(pdcrt_gc* gc, unsigned int clase, pdcrt_tipo_objeto_gc tipo, size_t tam_ranura, size_t num_ranuras)
+{
+    size_t tam_total = sizeof(pdcrt_pagina_gc) + tam_ranura * num_ranuras;
+    pdcrt_pagina_gc* pag = pdcrt_alojar_simple(gc->alojador_original, tam_total);
+    if(!pag)
         return NULL;
+
+    size_t indice;
+    if(gc->num_huecos > 0)
+    {
+        for(indice = 0; gc->paginas[indice] != NULL; indice++)
+            ;
+        gc->num_huecos -= 1;
+    }
+    else
+    {
+        if(gc->num_paginas == gc->cap_paginas)
+        {
+            size_t nueva_cap = pdcrt_siguiente_capacidad(gc->cap_paginas, gc->num_paginas, 1);
+            pdcrt_pagina_gc** paginas = pdcrt_realojar_simple(gc->alojador, gc->paginas,
+                                                              gc->cap_paginas * sizeof(pdcrt_pagina_gc*),
+                                                              nueva_cap * sizeof(pdcrt_pagina_gc*));
+            if(!paginas)
+            {
+                pdcrt_dealojar_simple(gc->alojador_original, pag, tam_total);
+                return NULL;
+            }
+            gc->paginas = paginas;
+            gc->cap_paginas = nueva_cap;
+        }
+        indice = gc->num_paginas++;
     }
+    PDCRT_ASSERT(indice < PDCRT_GC_PAGINA_DEL_VIVERO);
+    gc->paginas[indice] = pag;
+    gc->usado += tam_total;
+
+    pag->siguiente_con_espacio = NULL;
+    pag->tam_ranura = tam_ranura;
+    pag->num_ranuras = num_ranuras;
+    pag->num_ocupadas = 0;
+    pag->tam_total = tam_total;
+    pag->indice = indice;
+    pag->clase = clase;
+    pag->tipo = tipo;
+    pag->tiene_jovenes = false;
+    pag->con_espacio = false;
+    pag->por_barrer = false;
+    memset(pag->ocupadas, 0, sizeof(pag->ocupadas));
+    memset(pag->marcadas, 0, sizeof(pag->marcadas));
+    memset(pag->jovenes, 0, sizeof(pag->jovenes));
+    return pag;
 }
 
-void pdcrt_gc_dealojar(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
+static void pdcrt_gc_dealoj_pagina(pdcrt_gc* gc, pdcrt_pagina_gc* pag)
+{
+    gc->paginas[pag->indice] = NULL;
+    gc->num_huecos += 1;
+    gc->usado -= pag->tam_total;
+    pdcrt_dealojar_simple(gc->alojador_original, pag, pag->tam_total);
+}
+
+// Agrega `pag` a la lista de páginas con ranuras libres de su clase.
+static void pdcrt_gc_agregar_con_espacio(pdcrt_gc* gc, pdcrt_pagina_gc* pag)
+{
+    if(pag->con_espacio || pag->clase == PDCRT_GC_CLASE_GRANDE)
+        return;
+    pag->con_espacio = true;
+    pag->siguiente_con_espacio = gc->con_espacio[pag->clase];
+    gc->con_espacio[pag->clase] = pag;
+}
+
+size_t pdcrt_tam_de_objeto(pdcrt_cabecera_gc* obj)
 {
-    pdcrt_gc_olvidar(gc, obj);
     switch(obj->tipo)
     {
     case PDCRT_GC_TEXTO:
-        pdcrt_dealoj_texto(gc->alojador, (pdcrt_texto*) obj);
-        break;
+        return sizeof(pdcrt_texto);
     case PDCRT_GC_ESPACIO_DE_NOMBRES:
-        pdcrt_dealoj_espacio_de_nombres(gc->alojador, (pdcrt_espacio_de_nombres*) obj);
-        break;
+        return sizeof(pdcrt_espacio_de_nombres);
     case PDCRT_GC_ARREGLO:
-        pdcrt_dealoj_arreglo(gc->alojador, (pdcrt_arreglo*) obj);
-        break;
+        return sizeof(pdcrt_arreglo);
     case PDCRT_GC_ENV:
-        pdcrt_dealoj_env((pdcrt_env*) obj, gc->alojador);
-        break;
+        return PDCRT_GC_TAM_ENV(((pdcrt_env*) obj)->env_size);
     default:
         pdcrt_inalcanzable();
     }
 }
 
-static void pdcrt_gc_envejecer(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
+// Calcula `limite_completa` a partir del tamaño actual del montículo.
+static void pdcrt_gc_ajustar_limite(pdcrt_gc* gc)
 {
-    if(!obj->joven)
-        return;
-    pdcrt_eliminar_de_la_lista(&gc->objetos_jovenes, obj);
-    pdcrt_agregar_a_la_lista(&gc->objetos_viejos, obj);
-    obj->joven = false;
+    double limite = (double) gc->usado * gc->crecimiento;
+    if(limite < (double) gc->usado + (double) gc->tam_vivero)
+        limite = (double) gc->usado + (double) gc->tam_vivero;
+    if(gc->maximo > 0 && limite > (double) gc->maximo)
+        limite = (double) gc->maximo;
+    gc->limite_completa = (long long) limite;
 }
 
-void pdcrt_gc_marcar_como_que_contiene_joven(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
+// Lee un tamaño en bytes con un sufijo opcional `K`, `M` o `G`.
+static bool pdcrt_leer_tam(const char* txt, size_t* tam)
 {
-    if(obj->joven)
-        return;
-    pdcrt_eliminar_de_la_lista(&gc->objetos_viejos, obj);
-    pdcrt_agregar_a_la_lista(&gc->objetos_viejos_que_contienen_a_uno_joven, obj);
+    char* fin = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(txt, &fin, 10);
+    if(errno != 0 || fin == txt)
+        return false;
+    unsigned int desp = 0;
+    switch(*fin)
+    {
+    case 'k': case 'K': desp = 10; fin++; break;
+    case 'm': case 'M': desp = 20; fin++; break;
+    case 'g': case 'G': desp = 30; fin++; break;
+    default: break;
+    }
+    if(*fin != '\0' || v > (SIZE_MAX >> desp))
+        return false;
+    *tam = (size_t) v << desp;
+    return true;
 }
 
-void pdcrt_gc_write_barrier(struct pdcrt_contexto* ctx, struct pdcrt_objeto cont, struct pdcrt_objeto val)
+void pdcrt_gc_configurar_desde_el_entorno(pdcrt_gc* gc)
 {
-    pdcrt_cabecera_gc* cont_obj = pdcrt_cabecera_de_objeto(cont);
-    pdcrt_cabecera_gc* val_obj = pdcrt_cabecera_de_objeto(val);
-    if(!cont_obj || !val_obj || cont_obj->joven)
-        return;
-    pdcrt_gc_marcar_como_que_contiene_joven(&ctx->gc, cont_obj);
+    const char* txt;
+    if((txt = getenv("PDCRT_GC_VIVERO")) && *txt)
+    {
+        if(!pdcrt_leer_tam(txt, &gc->tam_vivero) || gc->tam_vivero == 0)
+        {
+            fprintf(stderr, u8"Valor inválido para PDCRT_GC_VIVERO: %s\n", txt);
+            exit(PDCRT_SALIDA_ERROR);
+        }
+    }
+    if((txt = getenv("PDCRT_GC_CRECIMIENTO")) && *txt)
+    {
+        char* fin = NULL;
+        double c = strtod(txt, &fin);
+        if(*fin != '\0' || !(c >= 1.0))
+        {
+            fprintf(stderr, u8"Valor inválido para PDCRT_GC_CRECIMIENTO: %s\n", txt);
+            exit(PDCRT_SALIDA_ERROR);
+        }
+        gc->crecimiento = c;
+    }
+    if((txt = getenv("PDCRT_GC_MAXIMO")) && *txt)
+    {
+        if(!pdcrt_leer_tam(txt, &gc->maximo))
+        {
+            fprintf(stderr, u8"Valor inválido para PDCRT_GC_MAXIMO: %s\n", txt);
+            exit(PDCRT_SALIDA_ERROR);
+        }
+    }
+    if((txt = getenv("PDCRT_GC_PASO")) && *txt)
+    {
+        if(!pdcrt_leer_tam(txt, &gc->paso))
+        {
+            fprintf(stderr, u8"Valor inválido para PDCRT_GC_PASO: %s\n", txt);
+            exit(PDCRT_SALIDA_ERROR);
+        }
+    }
+#if PDCRT_OPT_GC_HILOS > 0
+    if((txt = getenv("PDCRT_GC_HILOS")) && *txt)
+    {
+        if(!pdcrt_leer_tam(txt, &gc->hilos))
+        {
+            fprintf(stderr, u8"Valor inválido para PDCRT_GC_HILOS: %s\n", txt);
+            exit(PDCRT_SALIDA_ERROR);
+        }
+    }
+#endif
+    pdcrt_gc_ajustar_limite(gc);
+}
+
+#ifdef PDCRT_OPT_GNU
+// Realoja un bloque del espacio de objetos grandes: los bloques de al menos
+// `PDCRT_GC_TAM_BLOQUE_GRANDE` bytes viven en sus propias páginas de `mmap`,
+// así que crecen y se encogen con `mremap` (sin copiar sus bytes) y al
+// liberarse se le devuelven al sistema operativo. Solo se copia al cruzar el
+// límite en alguna dirección.
+static void* pdcrt_realojar_bloque_grande(pdcrt_gc* gc, void* ptr, size_t tam_viejo, size_t tam_nuevo)
+{
+    bool viejo_grande = tam_viejo >= PDCRT_GC_TAM_BLOQUE_GRANDE;
+    if(tam_nuevo >= PDCRT_GC_TAM_BLOQUE_GRANDE)
+    {
+        if(viejo_grande)
+        {
+            void* nuevo = mremap(ptr, tam_viejo, tam_nuevo, MREMAP_MAYMOVE);
+            return (nuevo == MAP_FAILED)? NULL : nuevo;
+        }
+        void* nuevo = mmap(NULL, tam_nuevo, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(nuevo == MAP_FAILED)
+            return NULL;
+        if(ptr)
+        {
+            memcpy(nuevo, ptr, tam_viejo);
+            pdcrt_dealojar_simple(gc->alojador_original, ptr, tam_viejo);
+        }
+        return nuevo;
+    }
+    PDCRT_ASSERT(viejo_grande);
+    void* nuevo = NULL;
+    if(tam_nuevo > 0)
+    {
+        nuevo = pdcrt_alojar_simple(gc->alojador_original, tam_nuevo);
+        if(!nuevo)
+            return NULL;
+        memcpy(nuevo, ptr, tam_nuevo);
+    }
+    munmap(ptr, tam_viejo);
+    return nuevo;
+}
+#endif
+
+// Los bloques grandes no cuentan en `alojados`: no ocupan el vivero y solo
+// hacen que la siguiente recolección completa llegue antes.
+static void* pdcrt_alojador_de_gc_impl(void* datos_del_usuario, void* ptr, size_t tam_viejo, size_t tam_nuevo)
+{
+    pdcrt_gc* gc = datos_del_usuario;
+    gc->usado -= tam_viejo;
+    gc->usado += tam_nuevo;
+    if(tam_viejo >= PDCRT_GC_TAM_BLOQUE_GRANDE || tam_nuevo >= PDCRT_GC_TAM_BLOQUE_GRANDE)
+    {
+        if(tam_viejo >= PDCRT_GC_TAM_BLOQUE_GRANDE)
+            gc->usado_grande -= tam_viejo;
+        if(tam_nuevo >= PDCRT_GC_TAM_BLOQUE_GRANDE)
+            gc->usado_grande += tam_nuevo;
+#ifdef PDCRT_OPT_GNU
+        return pdcrt_realojar_bloque_grande(gc, ptr, tam_viejo, tam_nuevo);
+#endif
+    }
+    else if(tam_nuevo > tam_viejo)
+    {
+        gc->alojados += tam_nuevo - tam_viejo;
+    }
+    return (*gc->alojador_original.alojar)(gc->alojador_original.datos, ptr, tam_viejo, tam_nuevo);
+}
+
+static pdcrt_alojador pdcrt_alojador_de_gc(pdcrt_gc* gc)
+{
+    return (pdcrt_alojador){ .alojar = &pdcrt_alojador_de_gc_impl, .datos = gc };
+}
+
+static void pdcrt_inic_pila_de_grises(pdcrt_pila_de_grises* grises)
+{
+    grises->elementos = NULL;
+    grises->num_elementos = 0;
+    grises->capacidad = 0;
+    grises->desbordada = false;
+}
+
+static void pdcrt_deinic_pila_de_grises(pdcrt_gc* gc, pdcrt_pila_de_grises* grises)
+{
+    if(grises->elementos)
+        pdcrt_dealojar_simple(gc->alojador_original, grises->elementos, grises->capacidad * sizeof(pdcrt_cabecera_gc*));
 }
 
-static void pdcrt_fijar_generacion_objeto(pdcrt_objeto obj, unsigned int gen, size_t* n, bool joven);
+pdcrt_error pdcrt_inic_gc(PDCRT_OUT pdcrt_gc* gc, pdcrt_alojador aloj)
+{
+    gc->alojador_original = aloj;
+    gc->paginas = NULL;
+    gc->num_paginas = 0;
+    gc->cap_paginas = 0;
+    gc->num_huecos = 0;
+    for(size_t i = 0; i < PDCRT_GC_NUM_CLASES; i++)
+    {
+        gc->con_espacio[i] = NULL;
+    }
+    gc->recordados = NULL;
+    gc->num_recordados = 0;
+    gc->cap_recordados = 0;
+    pdcrt_inic_pila_de_grises(&gc->grises);
+    pdcrt_inic_pila_de_grises(&gc->grises_viejos);
+    gc->marcando = false;
+    gc->proximo_paso = 0;
+    gc->por_barrer = 0;
+    gc->cursor_de_barrido = 0;
+    gc->vivero = NULL;
+    gc->vivero_libre = NULL;
+    gc->vivero_fin = NULL;
+    gc->num_en_vivero = 0;
+    gc->con_contenido = NULL;
+    gc->num_con_contenido = 0;
+    gc->cap_con_contenido = 0;
+    gc->usado = 0;
+    gc->usado_grande = 0;
+    gc->num_objetos = 0;
+    gc->alojador = pdcrt_alojador_de_gc(gc);
+    gc->alojados = 0;
+    gc->ciclo = 0;
+    gc->tam_vivero = PDCRT_OPT_GC_VIVERO;
+    gc->crecimiento = PDCRT_OPT_GC_CRECIMIENTO;
+    gc->maximo = PDCRT_OPT_GC_MAXIMO;
+    gc->paso = PDCRT_OPT_GC_PASO;
+    gc->hilos = PDCRT_OPT_GC_HILOS;
+    pdcrt_gc_ajustar_limite(gc);
+    return PDCRT_OK;
+}
 
-static void pdcrt_fijar_generacion_en_cabecera(pdcrt_cabecera_gc* obj, unsigned int gen, size_t* n, bool joven)
+// Desaloja lo que `obj` tenga fuera del montículo, pero no su ranura.
+static void pdcrt_gc_dealoj_contenido(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
 {
     switch(obj->tipo)
     {
     case PDCRT_GC_TEXTO:
-        if(obj->generacion == gen)
-            return;
-        if(joven && !obj->joven)
-            return;
-        *n += 1;
-        obj->generacion = gen;
+        pdcrt_dealoj_texto(gc->alojador, (pdcrt_texto*) obj);
         break;
-    case PDCRT_GC_ENV:
-        if(obj->generacion == gen)
-            return;
-        if(joven && !obj->joven)
-            return;
-        *n += 1;
-        pdcrt_env* env = (pdcrt_env*) obj;
-        obj->generacion = gen;
-        for(size_t i = 0; i < env->env_size; i++)
-        {
-            pdcrt_fijar_generacion_objeto(env->env[i], gen, n, joven);
-        }
+    case PDCRT_GC_ESPACIO_DE_NOMBRES:
+        pdcrt_dealoj_espacio_de_nombres(gc->alojador, (pdcrt_espacio_de_nombres*) obj);
         break;
     case PDCRT_GC_ARREGLO:
-        if(obj->generacion == gen)
-            return;
-        if(joven && !obj->joven)
-            return;
-        *n += 1;
-        obj->generacion = gen;
-        pdcrt_arreglo* arr = (pdcrt_arreglo*) obj;
-        for(size_t i = 0; i < arr->longitud; i++)
-        {
-            pdcrt_fijar_generacion_objeto(arr->elementos[i], gen, n, joven);
-        }
+        pdcrt_dealoj_arreglo(gc->alojador, (pdcrt_arreglo*) obj);
         break;
-    case PDCRT_GC_ESPACIO_DE_NOMBRES:
-        if(obj->generacion == gen)
-            return;
-        if(joven && !obj->joven)
-            return;
-        *n += 1;
-        obj->generacion = gen;
-        pdcrt_espacio_de_nombres* esp = (pdcrt_espacio_de_nombres*) obj;
-        for(size_t i = 0; i < esp->ultimo_nombre_creado; i++)
+    case PDCRT_GC_ENV:
+        break;
+    default:
+        pdcrt_inalcanzable();
+    }
+}
+
+void pdcrt_deinic_gc(pdcrt_gc* gc)
+{
+    for(size_t i = 0; i < gc->num_paginas; i++)
+    {
+        pdcrt_pagina_gc* pag = gc->paginas[i];
+        if(!pag)
+            continue;
+        if(pag->tipo != PDCRT_GC_ENV)
         {
-            pdcrt_fijar_generacion_objeto(esp->nombres[i].valor, gen, n, joven);
+            for(size_t w = 0; w < PDCRT_GC_PALABRAS_POR_MAPA; w++)
+            {
+                for(uint64_t r = pag->ocupadas[w]; r; r &= r - 1)
+                {
+                    pdcrt_gc_dealoj_contenido(gc, pdcrt_gc_objeto_en(pag, w * 64 + pdcrt_primer_bit(r)));
+                }
+            }
         }
-        break;
+        pdcrt_gc_dealoj_pagina(gc, pag);
+    }
+    if(gc->paginas)
+        pdcrt_dealojar_simple(gc->alojador, gc->paginas, gc->cap_paginas * sizeof(pdcrt_pagina_gc*));
+    if(gc->recordados)
+        pdcrt_dealojar_simple(gc->alojador, gc->recordados, gc->cap_recordados * sizeof(pdcrt_cabecera_gc*));
+    pdcrt_deinic_pila_de_grises(gc, &gc->grises);
+    pdcrt_deinic_pila_de_grises(gc, &gc->grises_viejos);
+    for(size_t i = 0; i < gc->num_con_contenido; i++)
+    {
+        pdcrt_gc_dealoj_contenido(gc, gc->con_contenido[i]);
     }
+    if(gc->con_contenido)
+        pdcrt_dealojar_simple(gc->alojador_original, gc->con_contenido, gc->cap_con_contenido * sizeof(pdcrt_cabecera_gc*));
+    if(gc->vivero)
+        pdcrt_dealojar_simple(gc->alojador_original, gc->vivero, gc->vivero_fin - gc->vivero);
 }
 
-static void pdcrt_fijar_generacion_en_objeto_viejo_que_contiene_a_uno_joven(pdcrt_cabecera_gc* obj, unsigned int gen, size_t* n)
+static size_t pdcrt_barrer_siguiente_pagina(pdcrt_gc* gc);
+
+// Aloja un objeto en una ranura libre de una página. Si `joven` es false el
+// objeto nace en la segunda generación (ver `pdcrt_gc_evacuar`). Antes de
+// crear una página nueva se barren las páginas pendientes hasta encontrar
+// una de la misma clase con espacio.
+static pdcrt_cabecera_gc* pdcrt_gc_alojar_en_paginas(pdcrt_gc* gc, size_t sz, pdcrt_tipo_objeto_gc tipo, bool joven)
 {
-    switch(obj->tipo)
+    unsigned int clase = pdcrt_gc_clase_de(sz, tipo);
+    pdcrt_pagina_gc* pag;
+    if(clase == PDCRT_GC_CLASE_GRANDE)
     {
-    case PDCRT_GC_TEXTO:
-        if(obj->generacion == gen)
-            return;
-        *n += 1;
-        obj->generacion = gen;
-        break;
-    case PDCRT_GC_ENV:
-        if(obj->generacion == gen)
-            return;
-        *n += 1;
-        pdcrt_env* env = (pdcrt_env*) obj;
-        obj->generacion = gen;
-        for(size_t i = 0; i < env->env_size; i++)
+        pag = pdcrt_gc_aloj_pagina(gc, clase, tipo, pdcrt_gc_tam_ranura(sz), 1);
+        if(!pag)
+            return NULL;
+    }
+    else
+    {
+        while(!gc->con_espacio[clase] && gc->por_barrer > 0)
+            pdcrt_barrer_siguiente_pagina(gc);
+        pag = gc->con_espacio[clase];
+        if(!pag)
         {
-            pdcrt_fijar_generacion_objeto(env->env[i], gen, n, true);
+            size_t tam_ranura = pdcrt_gc_tam_ranura(pdcrt_clases_gc[clase].tam);
+            pag = pdcrt_gc_aloj_pagina(gc, clase, tipo, tam_ranura, PDCRT_GC_TAM_PAGINA / tam_ranura);
+            if(!pag)
+                return NULL;
+            pdcrt_gc_agregar_con_espacio(gc, pag);
         }
-        break;
-    case PDCRT_GC_ARREGLO:
-        if(obj->generacion == gen)
-            return;
-        *n += 1;
-        obj->generacion = gen;
-        pdcrt_arreglo* arr = (pdcrt_arreglo*) obj;
-        for(size_t i = 0; i < arr->longitud; i++)
+    }
+
+    size_t ranura = 0;
+    for(size_t w = 0; w < PDCRT_GC_PALABRAS_POR_MAPA; w++)
+    {
+        uint64_t libres = ~pag->ocupadas[w] & pdcrt_gc_mascara(pag, w);
+        if(libres)
         {
-            pdcrt_fijar_generacion_objeto(arr->elementos[i], gen, n, true);
+            ranura = w * 64 + pdcrt_primer_bit(libres);
+            break;
         }
-        break;
-    case PDCRT_GC_ESPACIO_DE_NOMBRES:
-        if(obj->generacion == gen)
-            return;
-        *n += 1;
-        obj->generacion = gen;
-        pdcrt_espacio_de_nombres* esp = (pdcrt_espacio_de_nombres*) obj;
-        for(size_t i = 0; i < esp->ultimo_nombre_creado; i++)
+    }
+    uint64_t bit = UINT64_C(1) << (ranura % 64);
+    PDCRT_ASSERT(!(pag->ocupadas[ranura / 64] & bit));
+    pag->ocupadas[ranura / 64] |= bit;
+    if(joven)
+    {
+        pag->jovenes[ranura / 64] |= bit;
+        pag->tiene_jovenes = true;
+        gc->alojados += pag->tam_ranura;
+    }
+    pag->num_ocupadas += 1;
+    if(pag->num_ocupadas == pag->num_ranuras && pag->con_espacio)
+    {
+        PDCRT_ASSERT(gc->con_espacio[clase] == pag);
+        gc->con_espacio[clase] = pag->siguiente_con_espacio;
+        pag->siguiente_con_espacio = NULL;
+        pag->con_espacio = false;
+    }
+
+    pdcrt_cabecera_gc* obj = pdcrt_gc_objeto_en(pag, ranura);
+    obj->pagina = pag->indice;
+    obj->ranura = ranura;
+    obj->tipo = tipo;
+    obj->recordado = false;
+    gc->num_objetos += 1;
+    return obj;
+}
+
+// Aloja un objeto en el vivero. Devuelve NULL si no cabe.
+static pdcrt_cabecera_gc* pdcrt_gc_alojar_en_vivero(pdcrt_gc* gc, size_t sz, pdcrt_tipo_objeto_gc tipo)
+{
+    if(!gc->vivero)
+    {
+        gc->vivero = pdcrt_alojar_simple(gc->alojador_original, gc->tam_vivero);
+        if(!gc->vivero)
+            return NULL;
+        gc->vivero_libre = gc->vivero;
+        gc->vivero_fin = gc->vivero + gc->tam_vivero;
+        gc->usado += gc->tam_vivero;
+    }
+    size_t tam = pdcrt_gc_tam_ranura(sz);
+    if((size_t) (gc->vivero_fin - gc->vivero_libre) < tam)
+        return NULL;
+    pdcrt_cabecera_gc* obj = (pdcrt_cabecera_gc*) gc->vivero_libre;
+    if(tipo != PDCRT_GC_ENV)
+    {
+        if(gc->num_con_contenido == gc->cap_con_contenido)
         {
-            pdcrt_fijar_generacion_objeto(esp->nombres[i].valor, gen, n, true);
+            size_t nueva_cap = pdcrt_siguiente_capacidad(gc->cap_con_contenido, gc->num_con_contenido, 1);
+            pdcrt_cabecera_gc** con_contenido = pdcrt_realojar_simple(gc->alojador_original, gc->con_contenido,
+                                                                      gc->cap_con_contenido * sizeof(pdcrt_cabecera_gc*),
+                                                                      nueva_cap * sizeof(pdcrt_cabecera_gc*));
+            if(!con_contenido)
+                return NULL;
+            gc->con_contenido = con_contenido;
+            gc->cap_con_contenido = nueva_cap;
         }
-        break;
+        gc->con_contenido[gc->num_con_contenido++] = obj;
     }
+    gc->vivero_libre += tam;
+    obj->pagina = PDCRT_GC_PAGINA_DEL_VIVERO;
+    obj->ranura = 0;
+    obj->tipo = tipo;
+    obj->recordado = false;
+    gc->num_en_vivero += 1;
+    gc->num_objetos += 1;
+    gc->alojados += tam;
+    return obj;
 }
 
-static void pdcrt_fijar_generacion_objeto(pdcrt_objeto obj, unsigned int gen, size_t* n, bool joven)
+// Los textos nunca se alojan en el vivero: la tabla de textos, las cachés de
+// métodos y las constantes dependen de que no se muevan. Los objetos grandes
+// tampoco, ya que copiarlos costaría más que barrerlos.
+pdcrt_cabecera_gc* pdcrt_gc_alojar(pdcrt_gc* gc, size_t sz, pdcrt_tipo_objeto_gc tipo)
 {
-    switch(obj.tag)
+    if(tipo != PDCRT_GC_TEXTO && pdcrt_gc_clase_de(sz, tipo) != PDCRT_GC_CLASE_GRANDE)
     {
-    case PDCRT_TOBJ_ENTERO:
-    case PDCRT_TOBJ_FLOAT:
-    case PDCRT_TOBJ_MARCA_DE_PILA:
-    case PDCRT_TOBJ_BOOLEANO:
-    case PDCRT_TOBJ_NULO:
-    case PDCRT_TOBJ_VOIDPTR:
-        break;
-    case PDCRT_TOBJ_TEXTO:
-        return pdcrt_fijar_generacion_en_cabecera((pdcrt_cabecera_gc*) obj.value.t, gen, n, joven);
-    case PDCRT_TOBJ_CLOSURE:
-    case PDCRT_TOBJ_OBJETO:
-        return pdcrt_fijar_generacion_en_cabecera((pdcrt_cabecera_gc*) obj.value.c.env, gen, n, joven);
-    case PDCRT_TOBJ_ARREGLO:
-        return pdcrt_fijar_generacion_en_cabecera((pdcrt_cabecera_gc*) obj.value.a, gen, n, joven);
-    case PDCRT_TOBJ_ESPACIO_DE_NOMBRES:
-        return pdcrt_fijar_generacion_en_cabecera((pdcrt_cabecera_gc*) obj.value.e, gen, n, joven);
+        pdcrt_cabecera_gc* obj = pdcrt_gc_alojar_en_vivero(gc, sz, tipo);
+        if(obj)
+            return obj;
     }
+    return pdcrt_gc_alojar_en_paginas(gc, sz, tipo, true);
 }
 
-static void pdcrt_fijar_generacion_en_objetos_vivos(pdcrt_marco* marco, unsigned int gen, size_t* n, bool joven)
+void pdcrt_gc_olvidar(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
 {
-    for(pdcrt_marco* act = marco; act != NULL; act = act->marco_anterior)
+    PDCRT_ASSERT(!obj->recordado);
+    if(pdcrt_gc_en_vivero(obj))
     {
-        PDCRT_ASSERT(act->esta_vivo);
-        for(size_t i = 0; i < act->num_locales; i++)
+        // El espacio que ocupaba en el vivero se recupera en la siguiente
+        // recolección.
+        if(obj->tipo != PDCRT_GC_ENV)
         {
-            pdcrt_fijar_generacion_objeto(act->locales[i], gen, n, joven);
+            size_t i = gc->num_con_contenido;
+            while(gc->con_contenido[i - 1] != obj)
+                i -= 1;
+            gc->con_contenido[i - 1] = gc->con_contenido[--gc->num_con_contenido];
         }
+        gc->num_en_vivero -= 1;
+        gc->num_objetos -= 1;
+        return;
     }
+    pdcrt_pagina_gc* pag = pdcrt_gc_pagina_de(gc, obj);
+    uint64_t bit = UINT64_C(1) << (obj->ranura % 64);
+    PDCRT_ASSERT(pag->ocupadas[obj->ranura / 64] & bit);
+    pag->ocupadas[obj->ranura / 64] &= ~bit;
+    pag->jovenes[obj->ranura / 64] &= ~bit;
+    pag->num_ocupadas -= 1;
+    gc->num_objetos -= 1;
+    if(pag->clase == PDCRT_GC_CLASE_GRANDE)
+        pdcrt_gc_dealoj_pagina(gc, pag);
+    else
+        pdcrt_gc_agregar_con_espacio(gc, pag);
+}
+
+void pdcrt_gc_dealojar(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
+{
+    pdcrt_gc_dealoj_contenido(gc, obj);
+    pdcrt_gc_olvidar(gc, obj);
+}
+
+void pdcrt_gc_marcar_como_que_contiene_joven(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
+{
+    if(obj->recordado || pdcrt_gc_es_joven(gc, obj))
+        return;
+    if(gc->num_recordados == gc->cap_recordados)
+    {
+        size_t nueva_cap = pdcrt_siguiente_capacidad(gc->cap_recordados, gc->num_recordados, 1);
+        pdcrt_cabecera_gc** recordados = pdcrt_realojar_simple(gc->alojador, gc->recordados,
+                                                               gc->cap_recordados * sizeof(pdcrt_cabecera_gc*),
+                                                               nueva_cap * sizeof(pdcrt_cabecera_gc*));
+        if(!recordados)
+            no_falla(PDCRT_ENOMEM);
+        gc->recordados = recordados;
+        gc->cap_recordados = nueva_cap;
+    }
+    gc->recordados[gc->num_recordados++] = obj;
+    obj->recordado = true;
+}
+
+static pdcrt_cabecera_gc* pdcrt_cabecera_de_objeto(pdcrt_objeto obj)
+{
+    switch(obj.tag)
+    {
+    case PDCRT_TOBJ_TEXTO:
+        return (pdcrt_cabecera_gc*) obj.value.t;
+    case PDCRT_TOBJ_CLOSURE:
+    case PDCRT_TOBJ_OBJETO:
+        return (pdcrt_cabecera_gc*) obj.value.c.env;
+    case PDCRT_TOBJ_ARREGLO:
+        return (pdcrt_cabecera_gc*) obj.value.a;
+    case PDCRT_TOBJ_ESPACIO_DE_NOMBRES:
+        return (pdcrt_cabecera_gc*) obj.value.e;
+    default:
+        return NULL;
+    }
+}
+
+// Cómo se marca un objeto (ver `pdcrt_marcar_cabecera`).
+typedef enum pdcrt_modo_de_marcado
+{
+    // Una recolección de la primera generación: solo se marcan los objetos
+    // jóvenes.
+    PDCRT_MARCAR_JOVENES,
+    // El final de una recolección completa: se marcan todos los objetos.
+    PDCRT_MARCAR_TODOS,
+    // Un paso de una recolección completa: solo se marcan los objetos viejos
+    // y los jóvenes se ignoran (de ellos se encargan las recolecciones de la
+    // primera generación).
+    PDCRT_MARCAR_VIEJOS
+} pdcrt_modo_de_marcado;
+
+// Agrega `obj` (que ya fue marcado) a la pila de grises `grises`. Al mismo
+// tiempo se pide al procesador que traiga lo que se recorrerá cuando se saque
+// de la pila. Si la pila no puede crecer `obj` se queda marcado pero sin
+// recorrer: ver `pdcrt_terminar_de_marcar`.
+static void pdcrt_agregar_gris(pdcrt_gc* gc, pdcrt_pila_de_grises* grises, pdcrt_cabecera_gc* obj)
+{
+    switch(obj->tipo)
+    {
+    case PDCRT_GC_TEXTO:
+        return;
+    case PDCRT_GC_ENV:
+        PDCRT_PREFETCH(((pdcrt_env*) obj)->env);
+        break;
+    case PDCRT_GC_ARREGLO:
+        PDCRT_PREFETCH(((pdcrt_arreglo*) obj)->elementos);
+        break;
+    case PDCRT_GC_ESPACIO_DE_NOMBRES:
+        PDCRT_PREFETCH(((pdcrt_espacio_de_nombres*) obj)->nombres);
+        break;
+    }
+    if(grises->num_elementos == grises->capacidad)
+    {
+        size_t nueva_cap = pdcrt_siguiente_capacidad(grises->capacidad, grises->num_elementos, 1);
+        pdcrt_cabecera_gc** elementos = pdcrt_realojar_simple(gc->alojador_original, grises->elementos,
+                                                              grises->capacidad * sizeof(pdcrt_cabecera_gc*),
+                                                              nueva_cap * sizeof(pdcrt_cabecera_gc*));
+        if(!elementos)
+        {
+            grises->desbordada = true;
+            return;
+        }
+        grises->elementos = elementos;
+        grises->capacidad = nueva_cap;
+    }
+    grises->elementos[grises->num_elementos++] = obj;
+}
+
+// Marca a `obj`, que es viejo, para la recolección completa en curso y lo
+// agrega a `grises_viejos`.
+static void pdcrt_sombrear(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
+{
+    PDCRT_ASSERT(gc->marcando);
+    if(pdcrt_gc_marcar(gc, obj))
+        pdcrt_agregar_gris(gc, &gc->grises_viejos, obj);
+}
+
+void pdcrt_gc_write_barrier(struct pdcrt_contexto* ctx, struct pdcrt_objeto cont, struct pdcrt_objeto val)
+{
+    pdcrt_gc* gc = &ctx->gc;
+    pdcrt_cabecera_gc* val_obj = pdcrt_cabecera_de_objeto(val);
+    if(!val_obj)
+        return;
+    if(!pdcrt_gc_es_joven(gc, val_obj))
+    {
+        if(gc->marcando)
+            pdcrt_sombrear(gc, val_obj);
+        return;
+    }
+    pdcrt_cabecera_gc* cont_obj = pdcrt_cabecera_de_objeto(cont);
+    if(cont_obj)
+        pdcrt_gc_marcar_como_que_contiene_joven(gc, cont_obj);
+}
+
+// Les da tarjetas a `arr` (o hace crecer las que tiene) para que cubran toda
+// su capacidad. Si `arr` ya estaba en el conjunto recordado las tarjetas
+// nuevas empiezan sucias, ya que sus elementos pudieron recibir objetos
+// jóvenes antes de tener tarjetas.
+static void pdcrt_gc_cubrir_con_tarjetas(pdcrt_gc* gc, pdcrt_arreglo* arr)
+{
+    size_t num_tarjetas = (arr->capacidad + PDCRT_GC_ELEMENTOS_POR_TARJETA - 1) / PDCRT_GC_ELEMENTOS_POR_TARJETA;
+    if(num_tarjetas <= arr->num_tarjetas)
+        return;
+    uint8_t* tarjetas = pdcrt_realojar_simple(gc->alojador, arr->tarjetas, arr->num_tarjetas, num_tarjetas);
+    if(!tarjetas)
+        return;
+    memset(&tarjetas[arr->num_tarjetas], arr->gc.recordado, num_tarjetas - arr->num_tarjetas);
+    arr->tarjetas = tarjetas;
+    arr->num_tarjetas = num_tarjetas;
+}
+
+void pdcrt_gc_write_barrier_en_arreglo(struct pdcrt_contexto* ctx, struct pdcrt_arreglo* arr, size_t indice, struct pdcrt_objeto val)
+{
+    pdcrt_gc* gc = &ctx->gc;
+    size_t tarjeta = indice / PDCRT_GC_ELEMENTOS_POR_TARJETA;
+    if(tarjeta < arr->num_tarjetas && !gc->marcando)
+    {
+        arr->tarjetas[tarjeta] = 1;
+        return;
+    }
+    pdcrt_cabecera_gc* val_obj = pdcrt_cabecera_de_objeto(val);
+    if(!val_obj)
+        return;
+    if(!pdcrt_gc_es_joven(gc, val_obj))
+    {
+        if(gc->marcando)
+            pdcrt_sombrear(gc, val_obj);
+        return;
+    }
+    if(pdcrt_gc_es_joven(gc, &arr->gc))
+        return;
+    if(tarjeta >= arr->num_tarjetas && arr->capacidad > PDCRT_GC_ELEMENTOS_POR_TARJETA)
+        pdcrt_gc_cubrir_con_tarjetas(gc, arr);
+    pdcrt_gc_marcar_como_que_contiene_joven(gc, &arr->gc);
+    if(tarjeta < arr->num_tarjetas)
+        arr->tarjetas[tarjeta] = 1;
+}
+
+static void pdcrt_marcar_objeto(pdcrt_gc* gc, pdcrt_objeto* obj, size_t* n, pdcrt_modo_de_marcado modo);
+static void pdcrt_marcar_cabecera(pdcrt_gc* gc, pdcrt_cabecera_gc* obj, size_t* n, pdcrt_modo_de_marcado modo);
+
+// Marca los objetos contenidos por `obj` (pero no a `obj` mismo).
+static void pdcrt_marcar_hijos(pdcrt_gc* gc, pdcrt_cabecera_gc* obj, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    switch(obj->tipo)
+    {
+    case PDCRT_GC_TEXTO:
+        break;
+    case PDCRT_GC_ENV:
+    {
+        pdcrt_env* env = (pdcrt_env*) obj;
+        for(size_t i = 0; i < env->env_size; i++)
+        {
+            pdcrt_marcar_objeto(gc, &env->env[i], n, modo);
+        }
+        break;
+    }
+    case PDCRT_GC_ARREGLO:
+    {
+        pdcrt_arreglo* arr = (pdcrt_arreglo*) obj;
+        for(size_t i = 0; i < arr->longitud; i++)
+        {
+            pdcrt_marcar_objeto(gc, &arr->elementos[i], n, modo);
+        }
+        break;
+    }
+    case PDCRT_GC_ESPACIO_DE_NOMBRES:
+    {
+        pdcrt_espacio_de_nombres* esp = (pdcrt_espacio_de_nombres*) obj;
+        for(size_t i = 0; i < esp->ultimo_nombre_creado; i++)
+        {
+            pdcrt_marcar_cabecera(gc, &esp->nombres[i].nombre->gc, n, modo);
+            pdcrt_marcar_objeto(gc, &esp->nombres[i].valor, n, modo);
+        }
+        break;
+    }
+    }
+}
+
+// El número de referencias que `pdcrt_marcar_hijos` recorrerá en `obj`.
+static size_t pdcrt_num_hijos(pdcrt_cabecera_gc* obj)
+{
+    switch(obj->tipo)
+    {
+    case PDCRT_GC_ENV:
+        return ((pdcrt_env*) obj)->env_size;
+    case PDCRT_GC_ARREGLO:
+        return ((pdcrt_arreglo*) obj)->longitud;
+    case PDCRT_GC_ESPACIO_DE_NOMBRES:
+        return 2 * ((pdcrt_espacio_de_nombres*) obj)->ultimo_nombre_creado;
+    default:
+        return 0;
+    }
+}
+
+// Marca a `obj` y lo agrega a la pila de grises. En una recolección de la
+// primera generación los objetos viejos no se marcan ni se recorren (pero si
+// hay una recolección completa en curso se sombrean, ya que los objetos
+// jóvenes que los contienen serán promovidos ya marcados). En un paso de una
+// recolección completa solo se sombrean los objetos viejos.
+static void pdcrt_marcar_cabecera(pdcrt_gc* gc, pdcrt_cabecera_gc* obj, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    PDCRT_ASSERT(!pdcrt_gc_en_vivero(obj));
+    switch(modo)
+    {
+    case PDCRT_MARCAR_JOVENES:
+        if(!pdcrt_gc_es_joven(gc, obj))
+        {
+            if(gc->marcando)
+                pdcrt_sombrear(gc, obj);
+            return;
+        }
+        break;
+    case PDCRT_MARCAR_VIEJOS:
+        if(!pdcrt_gc_es_joven(gc, obj))
+            pdcrt_sombrear(gc, obj);
+        return;
+    case PDCRT_MARCAR_TODOS:
+        break;
+    }
+    if(!pdcrt_gc_marcar(gc, obj))
+        return;
+    *n += 1;
+    pdcrt_agregar_gris(gc, &gc->grises, obj);
+}
+
+// Marca los elementos de las tarjetas sucias de `arr` y los que no están
+// cubiertos por ninguna tarjeta.
+static void pdcrt_marcar_tarjetas(pdcrt_gc* gc, pdcrt_arreglo* arr, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    for(size_t t = 0; t < arr->num_tarjetas; t++)
+    {
+        if(!arr->tarjetas[t])
+            continue;
+        size_t inicio = t * PDCRT_GC_ELEMENTOS_POR_TARJETA;
+        size_t fin = inicio + PDCRT_GC_ELEMENTOS_POR_TARJETA;
+        if(fin > arr->longitud)
+            fin = arr->longitud;
+        for(size_t i = inicio; i < fin; i++)
+        {
+            pdcrt_marcar_objeto(gc, &arr->elementos[i], n, modo);
+        }
+    }
+    for(size_t i = arr->num_tarjetas * PDCRT_GC_ELEMENTOS_POR_TARJETA; i < arr->longitud; i++)
+    {
+        pdcrt_marcar_objeto(gc, &arr->elementos[i], n, modo);
+    }
+}
+
+// Marca los hijos de los objetos del conjunto recordado. Los objetos mismos
+// no se marcan: son viejos y su marca le pertenece a la recolección completa.
+static void pdcrt_marcar_recordados(pdcrt_gc* gc, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    for(size_t i = 0; i < gc->num_recordados; i++)
+    {
+        pdcrt_cabecera_gc* obj = gc->recordados[i];
+        if(obj->tipo == PDCRT_GC_ARREGLO && ((pdcrt_arreglo*) obj)->tarjetas)
+            pdcrt_marcar_tarjetas(gc, (pdcrt_arreglo*) obj, n, modo);
+        else
+            pdcrt_marcar_hijos(gc, obj, n, modo);
+    }
+}
+
+static void pdcrt_vaciar_grises(pdcrt_gc* gc, pdcrt_pila_de_grises* grises, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    while(grises->num_elementos > 0)
+    {
+        pdcrt_marcar_hijos(gc, grises->elementos[--grises->num_elementos], n, modo);
+    }
+}
+
+// Vacía la pila de grises. Si se desbordó, recorre los objetos marcados de
+// todo el montículo (alguno de ellos no fue recorrido) hasta que se pueda
+// terminar sin desbordarla.
+static void pdcrt_terminar_de_marcar(pdcrt_gc* gc, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    pdcrt_vaciar_grises(gc, &gc->grises, n, modo);
+    while(gc->grises.desbordada)
+    {
+        gc->grises.desbordada = false;
+        for(size_t i = 0; i < gc->num_paginas; i++)
+        {
+            pdcrt_pagina_gc* pag = gc->paginas[i];
+            if(!pag || pag->tipo == PDCRT_GC_TEXTO)
+                continue;
+            for(size_t w = 0; w < PDCRT_GC_PALABRAS_POR_MAPA; w++)
+            {
+                for(uint64_t r = pag->ocupadas[w] & pag->marcadas[w]; r; r &= r - 1)
+                {
+                    pdcrt_marcar_hijos(gc, pdcrt_gc_objeto_en(pag, w * 64 + pdcrt_primer_bit(r)), n, modo);
+                    pdcrt_vaciar_grises(gc, &gc->grises, n, modo);
+                }
+            }
+        }
+    }
+}
+
+// Copia `obj`, que está en el vivero, a una página y devuelve la copia. La
+// copia nace vieja y marcada, y se agrega a la pila de grises para que sus
+// hijos también se copien. En el vivero queda la dirección de la copia para
+// que las demás referencias a `obj` lleguen a ella.
+static pdcrt_cabecera_gc* pdcrt_gc_evacuar(pdcrt_gc* gc, pdcrt_cabecera_gc* obj, size_t* n)
+{
+    if(obj->ranura == PDCRT_GC_RANURA_REENVIADA)
+        return ((pdcrt_objeto_reenviado*) obj)->destino;
+    size_t tam = pdcrt_tam_de_objeto(obj);
+    pdcrt_cabecera_gc* copia = pdcrt_gc_alojar_en_paginas(gc, tam, obj->tipo, false);
+    if(!copia)
+        no_falla(PDCRT_ENOMEM);
+    uint32_t pagina = copia->pagina;
+    uint16_t ranura = copia->ranura;
+    memcpy(copia, obj, tam);
+    copia->pagina = pagina;
+    copia->ranura = ranura;
+    pdcrt_gc_marcar(gc, copia);
+    *n += 1;
+    obj->ranura = PDCRT_GC_RANURA_REENVIADA;
+    ((pdcrt_objeto_reenviado*) obj)->destino = copia;
+    pdcrt_agregar_gris(gc, &gc->grises, copia);
+    return copia;
+}
+
+static void pdcrt_fijar_cabecera_de_objeto(pdcrt_objeto* obj, pdcrt_cabecera_gc* cab)
+{
+    switch(obj->tag)
+    {
+    case PDCRT_TOBJ_CLOSURE:
+    case PDCRT_TOBJ_OBJETO:
+        obj->value.c.env = (pdcrt_env*) cab;
+        break;
+    case PDCRT_TOBJ_ARREGLO:
+        obj->value.a = (pdcrt_arreglo*) cab;
+        break;
+    case PDCRT_TOBJ_ESPACIO_DE_NOMBRES:
+        obj->value.e = (pdcrt_espacio_de_nombres*) cab;
+        break;
+    default:
+        pdcrt_inalcanzable();
+    }
+}
+
+// Marca el objeto al que apunta `obj`. Si está en el vivero lo copia a una
+// página y actualiza `obj` (excepto en un paso de una recolección completa,
+// que no toca el vivero).
+static void pdcrt_marcar_objeto(pdcrt_gc* gc, pdcrt_objeto* obj, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    pdcrt_cabecera_gc* cab = pdcrt_cabecera_de_objeto(*obj);
+    if(!cab)
+        return;
+    if(pdcrt_gc_en_vivero(cab))
+    {
+        if(modo != PDCRT_MARCAR_VIEJOS)
+            pdcrt_fijar_cabecera_de_objeto(obj, pdcrt_gc_evacuar(gc, cab, n));
+    }
+    else
+    {
+        pdcrt_marcar_cabecera(gc, cab, n, modo);
+    }
+}
+
+// Vacía el vivero tras marcar: sus objetos vivos ya fueron copiados, así que
+// solo queda liberar el contenido de los que murieron.
+static void pdcrt_vaciar_vivero(pdcrt_gc* gc)
+{
+    for(size_t i = 0; i < gc->num_con_contenido; i++)
+    {
+        pdcrt_cabecera_gc* obj = gc->con_contenido[i];
+        if(obj->ranura != PDCRT_GC_RANURA_REENVIADA)
+            pdcrt_gc_dealoj_contenido(gc, obj);
+    }
+    gc->num_con_contenido = 0;
+    gc->num_objetos -= gc->num_en_vivero;
+    gc->num_en_vivero = 0;
+    gc->vivero_libre = gc->vivero;
+}
+
+// Marca las locales de `marco` y de sus marcos anteriores. Muchos marcos
+// comparten la misma cadena de marcos anteriores, así que el recorrido se
+// detiene en el primer marco que ya fue recorrido en esta recolección: cada
+// marco se recorre una sola vez.
+static void pdcrt_marcar_objetos_vivos(pdcrt_gc* gc, pdcrt_marco* marco, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    for(pdcrt_marco* act = marco; act != NULL && act->ciclo_gc != gc->ciclo; act = act->marco_anterior)
+    {
+        PDCRT_ASSERT(act->esta_vivo);
+        act->ciclo_gc = gc->ciclo;
+        for(size_t i = 0; i < act->num_locales; i++)
+        {
+            pdcrt_marcar_objeto(gc, &act->locales[i], n, modo);
+        }
+    }
+}
+
+static void pdcrt_marcar_objetos_del_contexto(pdcrt_contexto* contexto, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    pdcrt_gc* gc = &contexto->gc;
+    for(size_t i = 0; i < contexto->pila.num_elementos; i++)
+    {
+        pdcrt_marcar_objeto(gc, &contexto->pila.elementos[i], n, modo);
+    }
+
+    for(size_t i = 0; i < contexto->constantes.num_textos; i++)
+    {
+        pdcrt_texto* texto = contexto->constantes.textos[i];
+        if(!texto)
+            continue;
+        *n += 1;
+        pdcrt_gc_marcar(gc, &texto->gc);
+    }
+
+#define PDCRT_MARCAR_CONST(cm, _lit) pdcrt_gc_marcar(gc, &contexto->constantes.cm->gc);
+    PDCRT_TABLA_DE_TEXTOS(PDCRT_MARCAR_CONST)
+#undef PDCRT_MARCAR_CONST
+
+        for(size_t i = 0; i < contexto->registro.num_modulos; i++)
+        {
+            pdcrt_modulo* mod = &contexto->registro.modulos[i];
+            *n += 1;
+            pdcrt_gc_marcar(gc, &mod->nombre->gc);
+            pdcrt_marcar_objeto(gc, &mod->valor, n, modo);
+        }
+
+    pdcrt_marcar_objeto(gc, &contexto->claseObjeto, n, modo);
+    pdcrt_marcar_objeto(gc, &contexto->entornoBootstrap, n, modo);
+}
+
+// Quita de la tabla de textos los que no fueron marcados (y que por lo
+// tanto serán barridos). Devuelve cuántos de los textos quitados eran
+// selectores de alguna caché de métodos.
+//
+// Los únicos textos jóvenes son los de `textos->nuevos`, así que una
+// recolección joven solo revisa esos y no toca el resto de la tabla ni
+// termina de migrarla.
+static size_t pdcrt_quitar_textos_muertos(pdcrt_gc* gc, pdcrt_textos* textos, bool joven)
+{
+    size_t quitados = 0, en_cache = 0;
+    if(joven)
+    {
+        for(size_t i = 0; i < textos->num_nuevos; i++)
+        {
+            pdcrt_texto* txt = textos->nuevos[i];
+            if(pdcrt_gc_esta_marcado(gc, &txt->gc) || !pdcrt_gc_es_joven(gc, &txt->gc))
+                continue;
+            // Si la tabla creció desde que se insertó el texto puede estar en
+            // cualquiera de las dos.
+            pdcrt_tabla_de_textos_quitar(&textos->actual, txt);
+            pdcrt_tabla_de_textos_quitar(&textos->anterior, txt);
+            quitados += 1;
+            en_cache += txt->en_cache;
+        }
+        textos->num_nuevos = 0;
+        textos->longitud -= quitados;
+        return en_cache;
+    }
+
+    textos->num_nuevos = 0;
+    pdcrt_textos_migrar(gc, textos, SIZE_MAX);
+    for(size_t i = 0; i < textos->actual.capacidad; i++)
+    {
+        pdcrt_ranura_de_textos* r = &textos->actual.ranuras[i];
+        if(!r->texto)
+            continue;
+        if(pdcrt_gc_esta_marcado(gc, &r->texto->gc))
+            continue;
+        en_cache += r->texto->en_cache;
+        r->texto = NULL;
+        r->hash = PDCRT_RANURA_DE_TEXTOS_BORRADA;
+        quitados += 1;
+    }
+    textos->longitud -= quitados;
+
+    // Si casi todas las ranuras ocupadas están borradas se reconstruye la
+    // tabla de una vez: la recolección ya tiene que recorrerla entera y así
+    // la siguiente migración no tiene que recorrer una tabla casi vacía.
+    size_t cap = pdcrt_textos_capacidad_para(textos->longitud);
+    if(cap < textos->actual.capacidad && textos->actual.ocupadas > 2 * textos->longitud)
+    {
+        pdcrt_tabla_de_textos nueva;
+        if(pdcrt_inic_tabla_de_textos(gc, cap, &nueva) == PDCRT_OK)
+        {
+            for(size_t i = 0; i < textos->actual.capacidad; i++)
+            {
+                pdcrt_ranura_de_textos* r = &textos->actual.ranuras[i];
+                if(r->texto)
+                    pdcrt_tabla_de_textos_insertar(&nueva, r->hash, r->texto);
+            }
+            pdcrt_deinic_tabla_de_textos(gc, &textos->actual);
+            textos->actual = nueva;
+        }
+    }
+    return en_cache;
+}
+
+// Barre una página: desaloja los objetos que no fueron marcados. Si
+// `solo_jovenes` es true solo se barren los objetos jóvenes. Los objetos que
+// sobrevivan pasan a la segunda generación, igual que los que se copian
+// desde el vivero.
+static void pdcrt_barrer_pagina(pdcrt_gc* gc, pdcrt_pagina_gc* pag, bool solo_jovenes, size_t* m)
+{
+    for(size_t w = 0; w < PDCRT_GC_PALABRAS_POR_MAPA; w++)
+    {
+        uint64_t muertos = pag->ocupadas[w] & ~pag->marcadas[w];
+        if(solo_jovenes)
+            muertos &= pag->jovenes[w];
+        if(muertos && pag->tipo != PDCRT_GC_ENV)
+        {
+            for(uint64_t r = muertos; r; r &= r - 1)
+            {
+                pdcrt_gc_dealoj_contenido(gc, pdcrt_gc_objeto_en(pag, w * 64 + pdcrt_primer_bit(r)));
+            }
+        }
+        size_t num_muertos = pdcrt_contar_bits(muertos);
+        pag->ocupadas[w] &= ~muertos;
+        pag->jovenes[w] = 0;
+        pag->num_ocupadas -= num_muertos;
+        gc->num_objetos -= num_muertos;
+        *m += num_muertos;
+    }
+    pag->tiene_jovenes = false;
+}
+
+// Barre todo el montículo y reconstruye las listas de páginas con espacio.
+// Las páginas vacías se liberan, excepto en las recolecciones de la primera
+// generación, en las que solo se liberan las páginas grandes (así las
+// páginas pequeñas pueden reusarse inmediatamente). Las páginas que esperan
+// el barrido perezoso se saltan.
+static void pdcrt_barrer_paginas(pdcrt_gc* gc, bool solo_jovenes, size_t* m, size_t* t)
+{
+    for(size_t i = 0; i < PDCRT_GC_NUM_CLASES; i++)
+    {
+        gc->con_espacio[i] = NULL;
+    }
+    for(size_t i = 0; i < gc->num_paginas; i++)
+    {
+        pdcrt_pagina_gc* pag = gc->paginas[i];
+        if(!pag)
+            continue;
+        *t += pag->num_ocupadas;
+        pag->con_espacio = false;
+        pag->siguiente_con_espacio = NULL;
+        if(pag->por_barrer)
+            continue;
+        if(!solo_jovenes || pag->tiene_jovenes)
+            pdcrt_barrer_pagina(gc, pag, solo_jovenes, m);
+        if(pag->num_ocupadas == 0 && (!solo_jovenes || pag->clase == PDCRT_GC_CLASE_GRANDE))
+            pdcrt_gc_dealoj_pagina(gc, pag);
+        else if(pag->num_ocupadas < pag->num_ranuras)
+            pdcrt_gc_agregar_con_espacio(gc, pag);
+    }
+}
+
+// Prepara el barrido perezoso tras una recolección completa: todas las
+// páginas quedan por barrer y sin espacio hasta que se barran (ver
+// `pdcrt_gc.por_barrer`).
+static void pdcrt_empezar_barrido(pdcrt_gc* gc)
+{
+    for(size_t i = 0; i < PDCRT_GC_NUM_CLASES; i++)
+    {
+        gc->con_espacio[i] = NULL;
+    }
+    for(size_t i = 0; i < gc->num_paginas; i++)
+    {
+        pdcrt_pagina_gc* pag = gc->paginas[i];
+        if(!pag)
+            continue;
+        pag->con_espacio = false;
+        pag->siguiente_con_espacio = NULL;
+        pag->por_barrer = true;
+        gc->por_barrer += 1;
+    }
+    gc->cursor_de_barrido = 0;
+#ifdef PDCRT_DBG_GC
+    printf("|Barrido pendiente: %zu páginas\n", gc->por_barrer);
+#endif
+}
+
+// Barre la siguiente página que está por barrer. Devuelve su número de
+// ranuras. Cuando se barre la última, el límite de la siguiente recolección
+// completa se calcula con el tamaño que quedó.
+static size_t pdcrt_barrer_siguiente_pagina(pdcrt_gc* gc)
+{
+    PDCRT_ASSERT(gc->por_barrer > 0);
+    pdcrt_pagina_gc* pag;
+    do
+    {
+        PDCRT_ASSERT(gc->cursor_de_barrido < gc->num_paginas);
+        pag = gc->paginas[gc->cursor_de_barrido++];
+    }
+    while(!pag || !pag->por_barrer);
+    size_t m = 0, num_ranuras = pag->num_ranuras;
+    pdcrt_barrer_pagina(gc, pag, false, &m);
+    pag->por_barrer = false;
+    gc->por_barrer -= 1;
+    if(pag->num_ocupadas == 0)
+        pdcrt_gc_dealoj_pagina(gc, pag);
+    else if(pag->num_ocupadas < pag->num_ranuras)
+        pdcrt_gc_agregar_con_espacio(gc, pag);
+    if(gc->por_barrer == 0)
+    {
+        pdcrt_gc_ajustar_limite(gc);
+#ifdef PDCRT_DBG_GC
+        printf("|Barrido terminado: usando %lld bytes\n", gc->usado);
+#endif
+    }
+    return num_ranuras;
+}
+
+// Barre páginas hasta haber recorrido `gc->paso` ranuras.
+static void pdcrt_paso_de_barrido(pdcrt_gc* gc)
+{
+    size_t trabajo = 0;
+    while(gc->por_barrer > 0 && trabajo < gc->paso)
+    {
+        trabajo += pdcrt_barrer_siguiente_pagina(gc);
+    }
+}
+
+// Barre todas las páginas que falten. Se debe llamar antes de borrar las
+// marcas de los objetos viejos.
+static void pdcrt_terminar_barrido(pdcrt_gc* gc)
+{
+    while(gc->por_barrer > 0)
+    {
+        pdcrt_barrer_siguiente_pagina(gc);
+    }
+}
+
+// Borra las marcas de los objetos. Si `solo_jovenes` es true las de los
+// objetos viejos se mantienen: son el progreso de la recolección completa en
+// curso.
+static void pdcrt_limpiar_marcas(pdcrt_gc* gc, bool solo_jovenes)
+{
+    for(size_t i = 0; i < gc->num_paginas; i++)
+    {
+        pdcrt_pagina_gc* pag = gc->paginas[i];
+        if(!pag)
+            continue;
+        if(!solo_jovenes)
+        {
+            memset(pag->marcadas, 0, sizeof(pag->marcadas));
+        }
+        else if(pag->tiene_jovenes)
+        {
+            for(size_t w = 0; w < PDCRT_GC_PALABRAS_POR_MAPA; w++)
+            {
+                pag->marcadas[w] &= ~pag->jovenes[w];
+            }
+        }
+    }
+}
+
+static void pdcrt_marcar_continuacion(pdcrt_gc* gc, pdcrt_continuacion* cont, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    switch(cont->tipo)
+    {
+    case PDCRT_CONT_DEVOLVER:
+        break;
+    case PDCRT_CONT_INICIAR:
+        pdcrt_marcar_objetos_vivos(gc, cont->valor.iniciar.marco_superior, n, modo);
+        break;
+    case PDCRT_CONT_CONTINUAR:
+        pdcrt_marcar_objetos_vivos(gc, cont->valor.continuar.marco_actual, n, modo);
+        break;
+    case PDCRT_CONT_ENVIAR_MENSAJE:
+        pdcrt_marcar_objetos_vivos(gc, cont->valor.enviar_mensaje.marco, n, modo);
+        pdcrt_marcar_objeto(gc, &cont->valor.enviar_mensaje.yo, n, modo);
+        pdcrt_marcar_objeto(gc, &cont->valor.enviar_mensaje.mensaje, n, modo);
+        break;
+    case PDCRT_CONT_TAIL_INICIAR:
+        pdcrt_marcar_objetos_vivos(gc, cont->valor.tail_iniciar.marco_superior, n, modo);
+        break;
+    case PDCRT_CONT_TAIL_ENVIAR_MENSAJE:
+        pdcrt_marcar_objetos_vivos(gc, cont->valor.tail_enviar_mensaje.marco_superior, n, modo);
+        pdcrt_marcar_objeto(gc, &cont->valor.tail_enviar_mensaje.yo, n, modo);
+        pdcrt_marcar_objeto(gc, &cont->valor.tail_enviar_mensaje.mensaje, n, modo);
+        break;
+    }
+}
+
+// Marca todo lo que es alcanzable directamente por el programa: el contexto,
+// los marcos y las continuaciones pendientes.
+static void pdcrt_marcar_raices(pdcrt_pila_de_continuaciones* pila, pdcrt_marco* marco, size_t* n, pdcrt_modo_de_marcado modo)
+{
+    pdcrt_contexto* contexto = marco->contexto;
+    pdcrt_gc* gc = &contexto->gc;
+    gc->ciclo += 1;
+    pdcrt_marcar_objetos_del_contexto(contexto, n, modo);
+    pdcrt_marcar_objetos_vivos(gc, marco, n, modo);
+    PDCRT_ASSERT(pila->marco_base->esta_vivo);
+    pdcrt_marcar_objetos_vivos(gc, pila->marco_base, n, modo);
+    size_t restantes = pila->num_elementos;
+    for(pdcrt_segmento_de_continuaciones* seg = pila->primero; restantes > 0; seg = seg->siguiente)
+    {
+        size_t en_seg = restantes < PDCRT_TAM_SEGMENTO_DE_CONTINUACIONES ? restantes : PDCRT_TAM_SEGMENTO_DE_CONTINUACIONES;
+        for(size_t i = 0; i < en_seg; i++)
+        {
+            // El marco del primer elemento es `marco_base`.
+            if(seg != pila->primero || i > 0)
+            {
+                PDCRT_ASSERT(seg->marcos[i].esta_vivo);
+                pdcrt_marcar_objetos_vivos(gc, &seg->marcos[i], n, modo);
+            }
+            pdcrt_marcar_continuacion(gc, &seg->continuaciones[i], n, modo);
+        }
+        restantes -= en_seg;
+    }
+}
+
+// Termina una recolección tras marcar: vacía el vivero, barre y prepara la
+// siguiente recolección.
+static void pdcrt_terminar_recoleccion(pdcrt_contexto* contexto, bool joven, size_t n)
+{
+    pdcrt_gc* gc = &contexto->gc;
+    size_t m = 0, t = 0;
+    pdcrt_vaciar_vivero(gc);
+    // Las cachés de métodos guardan punteros a textos: no pueden sobrevivir a
+    // los textos que se van a liberar. Los textos que nunca fueron selectores
+    // de una caché pueden morir sin vaciarlas.
+    if(pdcrt_quitar_textos_muertos(gc, &contexto->textos, joven) > 0)
+        pdcrt_invalidar_caches();
+#ifdef PDCRT_DBG_GC
+    printf("|Marcados %zu objetos\n", n);
+    if(joven)
+        printf("|Recoleccion joven\n");
+    else
+        printf("|Recoleccion completa\n");
+#else
+    (void) n;
+#endif
+    // Tras la recolección todos los objetos sobrevivientes son viejos, así que
+    // el conjunto recordado queda vacío. Solo se quedan los arreglos con
+    // tarjetas (ahora limpias) que sigan vivos.
+    size_t quedan = 0;
+    for(size_t i = 0; i < gc->num_recordados; i++)
+    {
+        pdcrt_cabecera_gc* obj = gc->recordados[i];
+        if(obj->tipo == PDCRT_GC_ARREGLO && ((pdcrt_arreglo*) obj)->tarjetas
+           && (joven || pdcrt_gc_esta_marcado(gc, obj)))
+        {
+            pdcrt_arreglo* arr = (pdcrt_arreglo*) obj;
+            memset(arr->tarjetas, 0, arr->num_tarjetas);
+            gc->recordados[quedan++] = obj;
+        }
+        else
+        {
+            obj->recordado = false;
+        }
+    }
+    gc->num_recordados = quedan;
+    // Con un máximo el barrido debe terminar aquí para poder comprobarlo.
+    if(!joven && gc->paso > 0 && gc->maximo == 0)
+        pdcrt_empezar_barrido(gc);
+    else
+        pdcrt_barrer_paginas(gc, joven, &m, &t);
+    gc->alojados = 0;
+    gc->proximo_paso = gc->tam_vivero / PDCRT_GC_PASOS_POR_VIVERO;
+    if(!joven && gc->por_barrer == 0)
+    {
+        pdcrt_gc_ajustar_limite(gc);
+        if(gc->maximo > 0 && gc->usado > (long long) gc->maximo)
+        {
+            fprintf(stderr, u8"Memoria agotada: el montículo usa %lld bytes (el máximo es %zu)\n", gc->usado, gc->maximo);
+            pdcrt_abort();
+        }
+    }
+#ifdef PDCRT_DBG_GC
+    printf("|Recolectados %zu objetos\n", m);
+    printf("|Total 1: %zu objetos\n", t);
+    printf("|Total 2: %zu objetos\n", gc->num_objetos);
+    printf("|Bloques grandes: %zu bytes\n", gc->usado_grande);
+#endif
+}
+
+// Recolecta la primera generación. Si hay una recolección completa en curso
+// los objetos viejos alcanzados se sombrean para ella.
+static void pdcrt_recolectar_jovenes(pdcrt_pila_de_continuaciones* pila, pdcrt_marco* marco)
+{
+    pdcrt_contexto* contexto = marco->contexto;
+    pdcrt_gc* gc = &contexto->gc;
+    size_t n = 0;
+    pdcrt_limpiar_marcas(gc, gc->marcando || gc->por_barrer > 0);
+    pdcrt_marcar_recordados(gc, &n, PDCRT_MARCAR_JOVENES);
+    pdcrt_marcar_raices(pila, marco, &n, PDCRT_MARCAR_JOVENES);
+    pdcrt_terminar_de_marcar(gc, &n, PDCRT_MARCAR_JOVENES);
+    pdcrt_terminar_recoleccion(contexto, true, n);
+}
+
+// Si la recolección completa actual debe terminar de marcar con varios hilos
+// (ver `pdcrt_marcar_en_paralelo`).
+static bool pdcrt_gc_usar_hilos(pdcrt_gc* gc)
+{
+#if PDCRT_OPT_GC_HILOS > 0
+    return gc->hilos > 1 && gc->usado >= PDCRT_GC_MIN_MARCADO_PARALELO;
+#else
+    (void) gc;
+    return false;
+#endif
+}
+
+#if PDCRT_OPT_GC_HILOS > 0
+// El número de objetos grises que cada hilo puede tener para sí mismo (ver
+// `pdcrt_marcador`).
+#define PDCRT_GC_GRISES_POR_HILO 1024
+
+// El estado compartido por los hilos que marcan el montículo.
+typedef struct pdcrt_marcado_paralelo
+{
+    pdcrt_gc* gc;
+    mtx_t cerrojo;
+    cnd_t hay_trabajo;
+    // Los objetos grises que cualquier hilo puede tomar. Como todo lo demás
+    // en esta estructura, solo se usa con `cerrojo` tomado.
+    pdcrt_pila_de_grises compartida;
+    size_t num_hilos;
+    // El número de hilos que esperan trabajo. Solo se modifica con `cerrojo`
+    // tomado, pero los hilos que tienen trabajo lo leen sin tomarlo para
+    // saber si deben compartirlo.
+    atomic_size_t ociosos;
+    bool terminado;
+} pdcrt_marcado_paralelo;
+
+// Uno de los hilos que marcan. Sus objetos grises están en `grises`, que solo
+// él usa: si otro hilo se queda sin trabajo le pasa la mitad a
+// `pdcrt_marcado_paralelo.compartida`.
+typedef struct pdcrt_marcador
+{
+    pdcrt_marcado_paralelo* par;
+    thrd_t hilo;
+    size_t num_grises;
+    pdcrt_cabecera_gc* grises[PDCRT_GC_GRISES_POR_HILO];
+} pdcrt_marcador;
+
+// Como `pdcrt_gc_marcar`, pero puede llamarse desde varios hilos a la vez.
+static bool pdcrt_gc_marcar_atomico(pdcrt_gc* gc, pdcrt_cabecera_gc* obj)
+{
+    pdcrt_pagina_gc* pag = pdcrt_gc_pagina_de(gc, obj);
+    uint64_t bit = UINT64_C(1) << (obj->ranura % 64);
+    _Atomic uint64_t* palabra = (_Atomic uint64_t*) &pag->marcadas[obj->ranura / 64];
+    if(atomic_load_explicit(palabra, memory_order_relaxed) & bit)
+        return false;
+    return !(atomic_fetch_or_explicit(palabra, bit, memory_order_relaxed) & bit);
+}
+
+// Pasa los `num` objetos grises de arriba de `m` a la pila compartida. Se
+// debe llamar con el cerrojo tomado.
+static void pdcrt_marcador_compartir(pdcrt_marcador* m, size_t num)
+{
+    pdcrt_marcado_paralelo* par = m->par;
+    for(size_t i = 0; i < num; i++)
+    {
+        pdcrt_agregar_gris(par->gc, &par->compartida, m->grises[--m->num_grises]);
+    }
+    cnd_broadcast(&par->hay_trabajo);
+}
+
+// Igual que en `pdcrt_paso_de_marcado`, los objetos jóvenes se ignoran: se
+// marcan al final de `pdcrt_recolectar_todo`.
+static void pdcrt_marcador_marcar(pdcrt_marcador* m, pdcrt_cabecera_gc* obj)
+{
+    pdcrt_gc* gc = m->par->gc;
+    if(pdcrt_gc_es_joven(gc, obj) || !pdcrt_gc_marcar_atomico(gc, obj) || obj->tipo == PDCRT_GC_TEXTO)
+        return;
+    if(m->num_grises == PDCRT_GC_GRISES_POR_HILO)
+    {
+        mtx_lock(&m->par->cerrojo);
+        pdcrt_marcador_compartir(m, PDCRT_GC_GRISES_POR_HILO / 2);
+        mtx_unlock(&m->par->cerrojo);
+    }
+    m->grises[m->num_grises++] = obj;
+}
+
+static void pdcrt_marcador_marcar_objeto(pdcrt_marcador* m, pdcrt_objeto obj)
+{
+    pdcrt_cabecera_gc* cab = pdcrt_cabecera_de_objeto(obj);
+    if(cab)
+        pdcrt_marcador_marcar(m, cab);
 }
 
-static void pdcrt_fijar_generacion_en_objetos_del_contexto(pdcrt_contexto* contexto, unsigned int gen, size_t* n, bool joven)
+static void pdcrt_marcador_marcar_hijos(pdcrt_marcador* m, pdcrt_cabecera_gc* obj)
 {
-    for(size_t i = 0; i < contexto->pila.num_elementos; i++)
-    {
-        pdcrt_fijar_generacion_objeto(contexto->pila.elementos[i], gen, n, joven);
-    }
-
-    for(size_t i = 0; i < contexto->textos.longitud; i++)
+    switch(obj->tipo)
     {
-        pdcrt_fijar_generacion_en_cabecera((pdcrt_cabecera_gc*) contexto->textos.textos[i], gen, n, joven);
-    }
-
-    if(joven)
+    case PDCRT_GC_TEXTO:
+        break;
+    case PDCRT_GC_ENV:
     {
-        for(pdcrt_cabecera_gc* obj = contexto->gc.objetos_viejos_que_contienen_a_uno_joven.primero; obj; obj = obj->siguiente)
+        pdcrt_env* env = (pdcrt_env*) obj;
+        for(size_t i = 0; i < env->env_size; i++)
         {
-            pdcrt_fijar_generacion_en_objeto_viejo_que_contiene_a_uno_joven(obj, gen, n);
+            pdcrt_marcador_marcar_objeto(m, env->env[i]);
         }
+        break;
     }
-
-    for(size_t i = 0; i < contexto->constantes.num_textos; i++)
+    case PDCRT_GC_ARREGLO:
     {
-        pdcrt_texto* texto = contexto->constantes.textos[i];
-        *n += 1;
-        texto->gc.generacion = gen;
-    }
-
-#define PDCRT_FIJAR_GEN(cm, _lit) contexto->constantes.cm->gc.generacion = gen
-    PDCRT_TABLA_DE_TEXTOS(PDCRT_FIJAR_GEN)
-#undef PDCRT_FIJAR_GEN
-
-        for(size_t i = 0; i < contexto->registro.num_modulos; i++)
+        pdcrt_arreglo* arr = (pdcrt_arreglo*) obj;
+        for(size_t i = 0; i < arr->longitud; i++)
         {
-            pdcrt_modulo mod = contexto->registro.modulos[i];
-            *n += 1;
-            mod.nombre->gc.generacion = gen;
-            pdcrt_fijar_generacion_objeto(mod.valor, gen, n, joven);
+            pdcrt_marcador_marcar_objeto(m, arr->elementos[i]);
         }
-
-    pdcrt_fijar_generacion_objeto(contexto->claseObjeto, gen, n, joven);
-    pdcrt_fijar_generacion_objeto(contexto->entornoBootstrap, gen, n, joven);
-}
-
-static void pdcrt_recolectar_objetos_jovenes_inalcanzables(pdcrt_contexto* contexto, unsigned int gen, size_t* m, size_t* t)
-{
-    for(pdcrt_cabecera_gc* obj = contexto->gc.objetos_jovenes.primero;
-        obj != NULL;)
+        break;
+    }
+    case PDCRT_GC_ESPACIO_DE_NOMBRES:
     {
-        *t += 1;
-        pdcrt_cabecera_gc* sig = obj->siguiente;
-        if(obj->joven && obj->generacion != gen)
+        pdcrt_espacio_de_nombres* esp = (pdcrt_espacio_de_nombres*) obj;
+        for(size_t i = 0; i < esp->ultimo_nombre_creado; i++)
         {
-            pdcrt_gc_dealojar(&contexto->gc, obj);
-            *m += 1;
+            pdcrt_marcador_marcar(m, &esp->nombres[i].nombre->gc);
+            pdcrt_marcador_marcar_objeto(m, esp->nombres[i].valor);
         }
-        obj = sig;
+        break;
+    }
     }
 }
 
-static void pdcrt_recolectar_objetos_inalcanzables(pdcrt_contexto* contexto, unsigned int gen, size_t* m, size_t* t)
+// El trabajo de cada hilo: recorre sus objetos grises y cuando se le acaban
+// toma más de la pila compartida. El marcado termina cuando todos los hilos
+// se quedan sin trabajo a la vez.
+static int pdcrt_marcador_trabajar(void* datos)
 {
-    for(pdcrt_cabecera_gc* obj = contexto->gc.objetos_jovenes.primero;
-        obj != NULL;)
+    pdcrt_marcador* m = datos;
+    pdcrt_marcado_paralelo* par = m->par;
+    while(true)
     {
-        *t += 1;
-        pdcrt_cabecera_gc* sig = obj->siguiente;
-        if(obj->generacion != gen)
+        while(m->num_grises > 0)
         {
-            pdcrt_gc_dealojar(&contexto->gc, obj);
-            *m += 1;
+            if(m->num_grises > 1 && atomic_load_explicit(&par->ociosos, memory_order_relaxed) > 0)
+            {
+                mtx_lock(&par->cerrojo);
+                if(par->compartida.num_elementos == 0)
+                    pdcrt_marcador_compartir(m, m->num_grises / 2);
+                mtx_unlock(&par->cerrojo);
+            }
+            pdcrt_marcador_marcar_hijos(m, m->grises[--m->num_grises]);
         }
-        else
+
+        mtx_lock(&par->cerrojo);
+        atomic_fetch_add_explicit(&par->ociosos, 1, memory_order_relaxed);
+        while(par->compartida.num_elementos == 0 && !par->terminado)
         {
-            pdcrt_gc_envejecer(&contexto->gc, obj);
+            if(atomic_load_explicit(&par->ociosos, memory_order_relaxed) == par->num_hilos)
+            {
+                par->terminado = true;
+                cnd_broadcast(&par->hay_trabajo);
+            }
+            else
+            {
+                cnd_wait(&par->hay_trabajo, &par->cerrojo);
+            }
         }
-        obj = sig;
-    }
-    for(pdcrt_cabecera_gc* obj = contexto->gc.objetos_viejos.primero;
-        obj != NULL;)
-    {
-        *t += 1;
-        pdcrt_cabecera_gc* sig = obj->siguiente;
-        if(obj->generacion != gen)
+        atomic_fetch_sub_explicit(&par->ociosos, 1, memory_order_relaxed);
+        if(par->terminado)
         {
-            pdcrt_gc_dealojar(&contexto->gc, obj);
-            *m += 1;
+            mtx_unlock(&par->cerrojo);
+            return 0;
         }
-        obj = sig;
-    }
-    for(pdcrt_cabecera_gc* obj = contexto->gc.objetos_viejos_que_contienen_a_uno_joven.primero;
-        obj != NULL;)
-    {
-        *t += 1;
-        pdcrt_cabecera_gc* sig = obj->siguiente;
-        if(obj->generacion != gen)
+        size_t lote = par->compartida.num_elementos / par->num_hilos + 1;
+        if(lote > PDCRT_GC_GRISES_POR_HILO)
+            lote = PDCRT_GC_GRISES_POR_HILO;
+        while(lote-- > 0 && par->compartida.num_elementos > 0)
         {
-            pdcrt_gc_dealojar(&contexto->gc, obj);
-            *m += 1;
+            m->grises[m->num_grises++] = par->compartida.elementos[--par->compartida.num_elementos];
         }
-        obj = sig;
+        mtx_unlock(&par->cerrojo);
     }
 }
 
-void pdcrt_recolectar_basura(PDCRT_ARR(num_marcos) struct pdcrt_marco* marcos,
-                             size_t num_marcos,
-                             struct pdcrt_marco* marco,
-                             PDCRT_ARR(num_cont) pdcrt_continuacion* continuaciones,
-                             size_t num_cont)
+// Vacía `grises_viejos` con `gc->hilos` hilos (contando al actual). Como en
+// `pdcrt_paso_de_marcado`, solo se recorren objetos viejos, así que los hilos
+// no copian ni alojan objetos: solo marcan. Si no se pueden crear los hilos se
+// marca con los que haya (en el peor caso solo con el actual).
+static void pdcrt_marcar_en_paralelo(pdcrt_gc* gc)
 {
-    pdcrt_contexto* contexto = marco->contexto;
-    if(contexto->generacionDelRecolector >= PDCRT_MAX_GENERACION)
+    size_t num_hilos = gc->hilos;
+    pdcrt_marcador* marcadores = pdcrt_alojar_simple(gc->alojador_original, num_hilos * sizeof(pdcrt_marcador));
+    if(!marcadores)
+        return;
+    pdcrt_marcado_paralelo par;
+    par.gc = gc;
+    if(mtx_init(&par.cerrojo, mtx_plain) != thrd_success)
     {
-        contexto->generacionDelRecolector = 0;
+        pdcrt_dealojar_simple(gc->alojador_original, marcadores, num_hilos * sizeof(pdcrt_marcador));
+        return;
     }
-    unsigned int gen = ++contexto->generacionDelRecolector;
-#ifdef PDCRT_DBG_GC
-    printf("|GC %u usando %lld bytes\n", gen, contexto->gc.usado);
-#endif
-    contexto->gc.mcnt = (contexto->gc.mcnt + 1) % 3;
-    bool joven = contexto->gc.mcnt < 2;
-    size_t n = 0, m = 0, t = 0;
-    pdcrt_fijar_generacion_en_objetos_del_contexto(marco->contexto, gen, &n, joven);
-    pdcrt_fijar_generacion_en_objetos_vivos(marco, gen, &n, joven);
-    for(size_t i = 0; i < num_marcos; i++)
+    if(cnd_init(&par.hay_trabajo) != thrd_success)
+    {
+        mtx_destroy(&par.cerrojo);
+        pdcrt_dealojar_simple(gc->alojador_original, marcadores, num_hilos * sizeof(pdcrt_marcador));
+        return;
+    }
+    par.compartida = gc->grises_viejos;
+    pdcrt_inic_pila_de_grises(&gc->grises_viejos);
+    par.num_hilos = 1;
+    atomic_init(&par.ociosos, 0);
+    par.terminado = false;
+    for(size_t i = 0; i < num_hilos; i++)
     {
-        PDCRT_ASSERT(marcos[i].esta_vivo);
-        pdcrt_fijar_generacion_en_objetos_vivos(&marcos[i], gen, &n, joven);
+        marcadores[i].par = &par;
+        marcadores[i].num_grises = 0;
     }
-    for(size_t i = 0; i < num_cont; i++)
+
+    mtx_lock(&par.cerrojo);
+    for(size_t i = 1; i < num_hilos; i++)
     {
-        switch(continuaciones[i].tipo)
+        par.num_hilos += 1;
+        if(thrd_create(&marcadores[i].hilo, &pdcrt_marcador_trabajar, &marcadores[i]) != thrd_success)
         {
-        case PDCRT_CONT_DEVOLVER:
-            break;
-        case PDCRT_CONT_INICIAR:
-            pdcrt_fijar_generacion_en_objetos_vivos(continuaciones[i].valor.iniciar.marco_superior, gen, &n, joven);
-            break;
-        case PDCRT_CONT_CONTINUAR:
-            pdcrt_fijar_generacion_en_objetos_vivos(continuaciones[i].valor.continuar.marco_actual, gen, &n, joven);
-            break;
-        case PDCRT_CONT_ENVIAR_MENSAJE:
-            pdcrt_fijar_generacion_en_objetos_vivos(continuaciones[i].valor.enviar_mensaje.marco, gen, &n, joven);
-            pdcrt_fijar_generacion_objeto(continuaciones[i].valor.enviar_mensaje.yo, gen, &n, joven);
-            pdcrt_fijar_generacion_objeto(continuaciones[i].valor.enviar_mensaje.mensaje, gen, &n, joven);
-            break;
-        case PDCRT_CONT_TAIL_INICIAR:
-            pdcrt_fijar_generacion_en_objetos_vivos(continuaciones[i].valor.tail_iniciar.marco_superior, gen, &n, joven);
-            break;
-        case PDCRT_CONT_TAIL_ENVIAR_MENSAJE:
-            pdcrt_fijar_generacion_en_objetos_vivos(continuaciones[i].valor.tail_enviar_mensaje.marco_superior, gen, &n, joven);
-            pdcrt_fijar_generacion_objeto(continuaciones[i].valor.tail_enviar_mensaje.yo, gen, &n, joven);
-            pdcrt_fijar_generacion_objeto(continuaciones[i].valor.tail_enviar_mensaje.mensaje, gen, &n, joven);
+            par.num_hilos -= 1;
             break;
         }
     }
+    mtx_unlock(&par.cerrojo);
+    pdcrt_marcador_trabajar(&marcadores[0]);
+    for(size_t i = 1; i < par.num_hilos; i++)
+    {
+        thrd_join(marcadores[i].hilo, NULL);
+    }
 #ifdef PDCRT_DBG_GC
-    printf("|Marcados %zu objetos\n", n);
-    if(!joven)
-        printf("|Recoleccion joven");
-    else
-        printf("|Recoleccion completa");
+    printf("|Marcado con %zu hilos\n", par.num_hilos);
 #endif
-    if(!joven)
+
+    // Si la pila compartida no pudo crecer algún objeto quedó sin recorrer:
+    // `pdcrt_recolectar_todo` se encarga de eso.
+    gc->grises_viejos = par.compartida;
+    cnd_destroy(&par.hay_trabajo);
+    mtx_destroy(&par.cerrojo);
+    pdcrt_dealojar_simple(gc->alojador_original, marcadores, num_hilos * sizeof(pdcrt_marcador));
+}
+#endif
+
+// Recolecta todo el montículo. Si ya se estaba marcando en pasos solo queda
+// terminar: se recorren otra vez las raíces y el conjunto recordado (que no
+// tienen write barrier) y lo que quede en `grises_viejos`.
+static void pdcrt_recolectar_todo(pdcrt_pila_de_continuaciones* pila, pdcrt_marco* marco)
+{
+    pdcrt_contexto* contexto = marco->contexto;
+    pdcrt_gc* gc = &contexto->gc;
+    size_t n = 0;
+    if(gc->marcando)
     {
-        pdcrt_recolectar_objetos_inalcanzables(contexto, gen, &m, &t);
+#if PDCRT_OPT_GC_HILOS > 0
+        if(pdcrt_gc_usar_hilos(gc))
+            pdcrt_marcar_en_paralelo(gc);
+#endif
+        pdcrt_limpiar_marcas(gc, true);
+        pdcrt_marcar_recordados(gc, &n, PDCRT_MARCAR_TODOS);
+        pdcrt_vaciar_grises(gc, &gc->grises_viejos, &n, PDCRT_MARCAR_TODOS);
+        gc->grises.desbordada |= gc->grises_viejos.desbordada;
+        gc->grises_viejos.desbordada = false;
     }
     else
     {
-        pdcrt_recolectar_objetos_jovenes_inalcanzables(contexto, gen, &m, &t);
+        pdcrt_terminar_barrido(gc);
+        pdcrt_limpiar_marcas(gc, false);
     }
+    pdcrt_marcar_raices(pila, marco, &n, PDCRT_MARCAR_TODOS);
+    pdcrt_terminar_de_marcar(gc, &n, PDCRT_MARCAR_TODOS);
+    gc->marcando = false;
+    pdcrt_terminar_recoleccion(contexto, false, n);
+}
+
+// Empieza a marcar el montículo para una recolección completa. Se empieza
+// con una recolección de la primera generación: así los objetos alcanzables
+// desde las raíces son promovidos ya marcados y los objetos viejos que
+// alcanzan quedan en `grises_viejos`. El resto del marcado se hace en pasos
+// (ver `pdcrt_paso_de_marcado`).
+static void pdcrt_empezar_marcado(pdcrt_pila_de_continuaciones* pila, pdcrt_marco* marco)
+{
+    pdcrt_gc* gc = &marco->contexto->gc;
 #ifdef PDCRT_DBG_GC
-    printf("|Recolectados %zu objetos\n", m);
-    printf("|Total 1: %zu objetos\n", t);
-    printf("|Total 2: %zu objetos\n", contexto->gc.num_objetos);
+    printf("|Empezando a marcar\n");
+#endif
+    pdcrt_terminar_barrido(gc);
+    pdcrt_limpiar_marcas(gc, false);
+    gc->marcando = true;
+    pdcrt_recolectar_jovenes(pila, marco);
+}
+
+// Recorre objetos de `grises_viejos` hasta haber visitado `gc->paso` objetos
+// y referencias. Devuelve true si ya no quedan objetos por recorrer.
+static bool pdcrt_paso_de_marcado(pdcrt_gc* gc)
+{
+    size_t trabajo = 0, n = 0;
+    while(gc->grises_viejos.num_elementos > 0 && trabajo < gc->paso)
+    {
+        pdcrt_cabecera_gc* obj = gc->grises_viejos.elementos[--gc->grises_viejos.num_elementos];
+        trabajo += 1 + pdcrt_num_hijos(obj);
+        pdcrt_marcar_hijos(gc, obj, &n, PDCRT_MARCAR_VIEJOS);
+    }
+#ifdef PDCRT_DBG_GC
+    printf("|Paso de marcado: %zu, quedan %zu grises\n", trabajo, gc->grises_viejos.num_elementos);
+#endif
+    return gc->grises_viejos.num_elementos == 0 && !gc->grises_viejos.desbordada;
+}
+
+// Si el programa aloja más rápido de lo que se marca, el montículo podría
+// crecer sin límite: en ese caso se termina el marcado de una vez.
+static bool pdcrt_marcado_atrasado(pdcrt_gc* gc)
+{
+    if(gc->maximo > 0 && gc->usado >= (long long) gc->maximo)
+        return true;
+    return gc->usado >= 2 * gc->limite_completa;
+}
+
+void pdcrt_recolectar_basura(pdcrt_pila_de_continuaciones* pila, struct pdcrt_marco* marco)
+{
+    pdcrt_gc* gc = &marco->contexto->gc;
+#ifdef PDCRT_DBG_GC
+    printf("|GC usando %lld bytes en %zu páginas\n", gc->usado, gc->num_paginas - gc->num_huecos);
+#endif
+    if(!gc->marcando && gc->por_barrer == 0 && gc->usado >= gc->limite_completa)
+    {
+        // Para marcar con varios hilos se empieza igual que al marcar en
+        // pasos: así los hilos solo tienen que recorrer objetos viejos.
+        if(gc->paso > 0 || pdcrt_gc_usar_hilos(gc))
+            pdcrt_empezar_marcado(pila, marco);
+        if(gc->paso == 0)
+            pdcrt_recolectar_todo(pila, marco);
+        return;
+    }
+    else if(gc->marcando && gc->alojados >= gc->proximo_paso)
+    {
+        if(pdcrt_paso_de_marcado(gc) || pdcrt_marcado_atrasado(gc))
+        {
+            pdcrt_recolectar_todo(pila, marco);
+            return;
+        }
+        gc->proximo_paso = gc->alojados + gc->tam_vivero / PDCRT_GC_PASOS_POR_VIVERO;
+    }
+    else if(gc->por_barrer > 0 && gc->alojados >= gc->proximo_paso)
+    {
+        pdcrt_paso_de_barrido(gc);
+        gc->proximo_paso = gc->alojados + gc->tam_vivero / PDCRT_GC_PASOS_POR_VIVERO;
+    }
+#ifndef PDCRT_PRB_SIEMPRE_GC
+    if(gc->alojados < gc->tam_vivero)
+        return;
 #endif
+    pdcrt_recolectar_jovenes(pila, marco);
 }
 
 bool pdcrt_deberia_recolectar_basura(pdcrt_gc* gc)
@@ -3953,8 +5809,11 @@ bool pdcrt_deberia_recolectar_basura(pdcrt_gc* gc)
 #ifdef PDCRT_PRB_SIEMPRE_GC
     return true;
 #else
-    gc->cnt = (gc->cnt + 1) % 80000;
-    return gc->cnt == 0;
+    if(gc->alojados >= gc->tam_vivero)
+        return true;
+    if(gc->marcando || gc->por_barrer > 0)
+        return gc->alojados >= gc->proximo_paso;
+    return gc->usado >= gc->limite_completa;
 #endif
 }
 
@@ -3990,51 +5849,113 @@ void pdcrt_op_fconst(pdcrt_marco* marco, pdcrt_float c)
     msj = pdcrt_objeto_desde_texto(marco->contexto->constantes.binop);  \
     return pdcrt_continuacion_enviar_mensaje(proc, marco, b, msj, 1, 1);
 
+// Como `PDCRT_OP`, pero si ambos operandos son números calcula el resultado
+// directamente y continúa sin enviar el mensaje.
+#define PDCRT_OP_ARITMETICA(marco, operacion, binop, proc)              \
+    pdcrt_objeto res;                                                   \
+    pdcrt_objeto rhs = pdcrt_elemento_de_pila(&marco->contexto->pila, 0); \
+    pdcrt_objeto yo = pdcrt_elemento_de_pila(&marco->contexto->pila, 1); \
+    if(pdcrt_operar_numeros(yo, rhs, operacion, &res))                  \
+    {                                                                   \
+        (void) pdcrt_sacar_de_pila(&marco->contexto->pila);             \
+        (void) pdcrt_sacar_de_pila(&marco->contexto->pila);             \
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, res)); \
+        return pdcrt_continuacion_normal(proc, marco);                  \
+    }                                                                   \
+    PDCRT_OP(marco, binop, proc)
+
 pdcrt_continuacion pdcrt_op_sum(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
-    PDCRT_OP(marco, operador_mas, proc);
+    PDCRT_OP_ARITMETICA(marco, PDCRT_SUMA, operador_mas, proc);
 }
 
 pdcrt_continuacion pdcrt_op_sub(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
-    PDCRT_OP(marco, operador_menos, proc);
+    PDCRT_OP_ARITMETICA(marco, PDCRT_RESTA, operador_menos, proc);
 }
 
 pdcrt_continuacion pdcrt_op_mul(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
-    PDCRT_OP(marco, operador_por, proc);
+    PDCRT_OP_ARITMETICA(marco, PDCRT_MULTIPLICACION, operador_por, proc);
 }
 
 pdcrt_continuacion pdcrt_op_div(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
-    PDCRT_OP(marco, operador_entre, proc);
+    PDCRT_OP_ARITMETICA(marco, PDCRT_DIVISION, operador_entre, proc);
+}
+
+// Determina si el receptor `obj` es un escalar que compara usando
+// `pdcrt_objeto_escalar_iguales`. Los objetos pueden redefinir `igualA`, así
+// que no son escalares.
+static bool pdcrt_es_escalar_comparable(pdcrt_objeto obj)
+{
+    switch(obj.tag)
+    {
+    case PDCRT_TOBJ_ENTERO:
+    case PDCRT_TOBJ_FLOAT:
+    case PDCRT_TOBJ_BOOLEANO:
+    case PDCRT_TOBJ_NULO:
+    case PDCRT_TOBJ_TEXTO:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Reemplaza los dos operandos en la cima de la pila por el booleano `res`.
+static pdcrt_continuacion pdcrt_continuar_con_comparacion(pdcrt_marco* marco, bool res, pdcrt_proc_continuacion proc)
+{
+    (void) pdcrt_sacar_de_pila(&marco->contexto->pila);
+    (void) pdcrt_sacar_de_pila(&marco->contexto->pila);
+    no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(res)));
+    return pdcrt_continuacion_normal(proc, marco);
 }
 
+// Como `PDCRT_OP`, pero si ambos operandos son números los compara
+// directamente y continúa sin enviar el mensaje.
+#define PDCRT_OP_COMPARACION(marco, comparacion, binop, proc)           \
+    pdcrt_objeto rhs = pdcrt_elemento_de_pila(&marco->contexto->pila, 0); \
+    pdcrt_objeto yo = pdcrt_elemento_de_pila(&marco->contexto->pila, 1); \
+    if(pdcrt_es_numero(yo.tag) && pdcrt_es_numero(rhs.tag))             \
+    {                                                                   \
+        bool res = pdcrt_comparar_escalares_numericos(yo, rhs, comparacion); \
+        return pdcrt_continuar_con_comparacion(marco, res, proc);       \
+    }                                                                   \
+    PDCRT_OP(marco, binop, proc)
+
 pdcrt_continuacion pdcrt_op_gt(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
-    PDCRT_OP(marco, operador_mayorQue, proc);
+    PDCRT_OP_COMPARACION(marco, PDCRT_MAYOR_QUE, operador_mayorQue, proc);
 }
 
 pdcrt_continuacion pdcrt_op_ge(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
-    PDCRT_OP(marco, operador_mayorOIgualA, proc);
+    PDCRT_OP_COMPARACION(marco, PDCRT_MAYOR_O_IGUAL_A, operador_mayorOIgualA, proc);
 }
 
 pdcrt_continuacion pdcrt_op_lt(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
-    PDCRT_OP(marco, operador_menorQue, proc);
+    PDCRT_OP_COMPARACION(marco, PDCRT_MENOR_QUE, operador_menorQue, proc);
 }
 
 pdcrt_continuacion pdcrt_op_le(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
-    PDCRT_OP(marco, operador_menorOIgualA, proc);
+    PDCRT_OP_COMPARACION(marco, PDCRT_MENOR_O_IGUAL_A, operador_menorOIgualA, proc);
 }
 
 pdcrt_continuacion pdcrt_op_opeq(pdcrt_marco* marco, pdcrt_proc_continuacion proc)
 {
+    pdcrt_objeto rhs = pdcrt_elemento_de_pila(&marco->contexto->pila, 0);
+    pdcrt_objeto yo = pdcrt_elemento_de_pila(&marco->contexto->pila, 1);
+    if(pdcrt_es_escalar_comparable(yo))
+    {
+        return pdcrt_continuar_con_comparacion(marco, pdcrt_objeto_escalar_iguales(yo, rhs), proc);
+    }
     PDCRT_OP(marco, operador_igualA, proc);
 }
 
+#undef PDCRT_OP_COMPARACION
+#undef PDCRT_OP_ARITMETICA
 #undef PDCRT_OP
 
 void pdcrt_op_pop(pdcrt_marco* marco)
@@ -4147,7 +6068,7 @@ void pdcrt_op_mkarr(pdcrt_marco* marco, size_t tam)
     {
         pdcrt_objeto elemento = pdcrt_sacar_de_pila(&marco->contexto->pila);
         arr.value.a->elementos[tam - i - 1] = elemento;
-        pdcrt_gc_write_barrier(marco->contexto, arr, elemento);
+        pdcrt_gc_write_barrier_en_arreglo(marco->contexto, arr.value.a, tam - i - 1, elemento);
     }
     no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, arr));
 }
@@ -4255,6 +6176,13 @@ pdcrt_continuacion pdcrt_op_cmp(pdcrt_marco* marco, pdcrt_cmp cmp, pdcrt_proc_co
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(pdcrt_objeto_identicos(a, b))));
         return pdcrt_continuacion_normal(proc, marco);
     }
+    else if(pdcrt_es_escalar_comparable(a))
+    {
+        PDCRT_ASSERT(cmp == PDCRT_CMP_EQ || cmp == PDCRT_CMP_NEQ);
+        bool iguales = pdcrt_objeto_escalar_iguales(a, b);
+        no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano((cmp == PDCRT_CMP_EQ)? iguales : !iguales)));
+        return pdcrt_continuacion_normal(proc, marco);
+    }
     else
     {
         PDCRT_ASSERT(cmp == PDCRT_CMP_EQ || cmp == PDCRT_CMP_NEQ);
@@ -4334,6 +6262,190 @@ pdcrt_continuacion pdcrt_op_tail_msg(pdcrt_marco* marco, int cid, int args, int
     return pdcrt_continuacion_tail_enviar_mensaje(marco_superior, obj, mensaje, args, rets);
 }
 
+static pdcrt_continuacion pdcrt_metodo_generico(pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
+{
+    return pdcrt_continuacion_tail_enviar_mensaje(marco_superior, yo, msj, args, rets);
+}
+
+// Los receptores predefinidos solo devuelven `PDCRT_CONT_DEVOLVER` o
+// continuaciones "tail", así que su marco nunca sobrevive al receptor y se
+// puede alojar en la pila de C en vez de en la del trampolín.
+static pdcrt_continuacion pdcrt_metodo_nativo(pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
+{
+    pdcrt_marco marco;
+    pdcrt_continuacion k = PDCRT_CONV_RECV(yo.recv)(&marco, marco_superior, yo, msj, args, rets);
+    pdcrt_deinic_marco(&marco);
+    return k;
+}
+
+static pdcrt_continuacion pdcrt_metodo_llamar_closure(pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
+{
+    (void) msj;
+    no_falla(pdcrt_empujar_en_pila(&marco_superior->contexto->pila, marco_superior->contexto->alojador, yo));
+    return pdcrt_continuacion_tail_iniciar((pdcrt_proc_t) yo.value.c.proc, marco_superior, args + 1, rets);
+}
+
+static pdcrt_continuacion pdcrt_metodo_objeto(pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
+{
+    pdcrt_insertar_elemento_en_pila(&marco_superior->contexto->pila, marco_superior->contexto->alojador, args, msj);
+    no_falla(pdcrt_empujar_en_pila(&marco_superior->contexto->pila, marco_superior->contexto->alojador, yo));
+    return pdcrt_continuacion_tail_iniciar((pdcrt_proc_t) yo.value.c.proc, marco_superior, args + 2, rets);
+}
+
+pdcrt_metodo pdcrt_resolver_metodo(pdcrt_funcion_generica recv, pdcrt_texto* selector)
+{
+    if(recv == (pdcrt_funcion_generica) &pdcrt_recv_objeto)
+        return &pdcrt_metodo_objeto;
+    if(recv == (pdcrt_funcion_generica) &pdcrt_recv_closure && selector->selector == PDCRT_SEL_msj_llamar)
+        return &pdcrt_metodo_llamar_closure;
+    if(recv == (pdcrt_funcion_generica) &pdcrt_recv_numero
+       || recv == (pdcrt_funcion_generica) &pdcrt_recv_texto
+       || recv == (pdcrt_funcion_generica) &pdcrt_recv_closure
+       || recv == (pdcrt_funcion_generica) &pdcrt_recv_booleano
+       || recv == (pdcrt_funcion_generica) &pdcrt_recv_nulo
+       || recv == (pdcrt_funcion_generica) &pdcrt_recv_arreglo
+       || recv == (pdcrt_funcion_generica) &pdcrt_recv_espacio_de_nombres
+       || recv == (pdcrt_funcion_generica) &pdcrt_recv_rt)
+        return &pdcrt_metodo_nativo;
+    return &pdcrt_metodo_generico;
+}
+
+// Convierte la continuación devuelta por un método en un envío normal (no
+// "tail") a la continuación `proc` de `marco`.
+static pdcrt_continuacion pdcrt_continuar_tras_metodo(pdcrt_marco* marco, pdcrt_proc_continuacion proc, pdcrt_continuacion k)
+{
+    switch(k.tipo)
+    {
+    case PDCRT_CONT_DEVOLVER:
+        return pdcrt_continuacion_normal(proc, marco);
+    case PDCRT_CONT_TAIL_INICIAR:
+        PDCRT_ASSERT(k.valor.tail_iniciar.marco_superior == marco);
+        return pdcrt_continuacion_iniciar((pdcrt_proc_t) k.valor.tail_iniciar.proc,
+                                          proc,
+                                          marco,
+                                          k.valor.tail_iniciar.args,
+                                          k.valor.tail_iniciar.rets);
+    case PDCRT_CONT_TAIL_ENVIAR_MENSAJE:
+        PDCRT_ASSERT(k.valor.tail_enviar_mensaje.marco_superior == marco);
+        return pdcrt_continuacion_enviar_mensaje(proc,
+                                                 marco,
+                                                 k.valor.tail_enviar_mensaje.yo,
+                                                 k.valor.tail_enviar_mensaje.mensaje,
+                                                 k.valor.tail_enviar_mensaje.args,
+                                                 k.valor.tail_enviar_mensaje.rets);
+    default:
+        pdcrt_inalcanzable();
+    }
+}
+
+// PDCRT_TAM_CACHE_MEGAMORFICA es el número de entradas de la caché global de
+// métodos. Debe ser una potencia de 2.
+#define PDCRT_TAM_CACHE_MEGAMORFICA 256
+static pdcrt_entrada_de_cache pdcrt_cache_megamorfica[PDCRT_TAM_CACHE_MEGAMORFICA];
+static size_t pdcrt_cache_megamorfica_aciertos = 0;
+static size_t pdcrt_cache_megamorfica_fallos = 0;
+static pdcrt_cache_de_mensaje* pdcrt_caches_registradas = NULL;
+
+static size_t pdcrt_hash_de_metodo(pdcrt_funcion_generica recv, pdcrt_texto* selector)
+{
+    uintptr_t h = ((uintptr_t) recv >> 4) ^ ((uintptr_t) selector >> 4);
+    h ^= h >> 7;
+    return h & (PDCRT_TAM_CACHE_MEGAMORFICA - 1);
+}
+
+static pdcrt_metodo pdcrt_buscar_metodo(pdcrt_cache_de_mensaje* cache, pdcrt_funcion_generica recv, pdcrt_texto* selector)
+{
+    for(size_t i = 0; i < cache->num_entradas; i++)
+    {
+        pdcrt_entrada_de_cache* ent = &cache->entradas[i];
+        if(ent->recv == recv && ent->selector == selector)
+        {
+            cache->aciertos += 1;
+            return ent->metodo;
+        }
+    }
+
+    cache->fallos += 1;
+    if(!cache->registrado)
+    {
+        cache->registrado = true;
+        cache->siguiente = pdcrt_caches_registradas;
+        pdcrt_caches_registradas = cache;
+    }
+
+    pdcrt_entrada_de_cache* ent;
+    if(cache->num_entradas < PDCRT_TAM_CACHE_POLIMORFICA)
+    {
+        ent = &cache->entradas[cache->num_entradas];
+        cache->num_entradas += 1;
+    }
+    else
+    {
+        cache->megamorfico = true;
+        ent = &pdcrt_cache_megamorfica[pdcrt_hash_de_metodo(recv, selector)];
+        if(ent->recv == recv && ent->selector == selector)
+        {
+            pdcrt_cache_megamorfica_aciertos += 1;
+            return ent->metodo;
+        }
+        pdcrt_cache_megamorfica_fallos += 1;
+    }
+    ent->recv = recv;
+    ent->selector = selector;
+    selector->en_cache = true;
+    ent->metodo = pdcrt_resolver_metodo(recv, selector);
+    return ent->metodo;
+}
+
+// Las cachés guardan punteros a textos, así que deben vaciarse antes de que
+// esos textos puedan ser liberados.
+static void pdcrt_invalidar_caches(void)
+{
+    for(pdcrt_cache_de_mensaje* cache = pdcrt_caches_registradas; cache; cache = cache->siguiente)
+    {
+        cache->num_entradas = 0;
+        cache->megamorfico = false;
+    }
+    memset(pdcrt_cache_megamorfica, 0, sizeof(pdcrt_cache_megamorfica));
+}
+
+void pdcrt_escribir_estadisticas_de_las_caches(FILE* out)
+{
+    fprintf(out, u8"|Caché megamórfica: %zu aciertos, %zu fallos\n",
+            pdcrt_cache_megamorfica_aciertos, pdcrt_cache_megamorfica_fallos);
+    for(pdcrt_cache_de_mensaje* cache = pdcrt_caches_registradas; cache; cache = cache->siguiente)
+    {
+        fprintf(out, "|  Sitio %s: %zu aciertos, %zu fallos%s\n",
+                cache->sitio? cache->sitio : "<desconocido>",
+                cache->aciertos,
+                cache->fallos,
+                cache->megamorfico? u8" (megamórfico)" : "");
+    }
+}
+
+pdcrt_continuacion pdcrt_op_msg_cache(pdcrt_marco* marco, pdcrt_proc_continuacion proc, pdcrt_cache_de_mensaje* cache, int cid, int args, int rets)
+{
+    pdcrt_texto* selector = marco->contexto->constantes.textos[cid];
+    pdcrt_objeto obj = pdcrt_sacar_de_pila(&marco->contexto->pila);
+    pdcrt_metodo metodo = pdcrt_buscar_metodo(cache, obj.recv, selector);
+    pdcrt_continuacion k = (*metodo)(marco, obj, pdcrt_objeto_desde_texto(selector), args, rets);
+    return pdcrt_continuar_tras_metodo(marco, proc, k);
+}
+
+pdcrt_continuacion pdcrt_op_tail_msg_cache(pdcrt_marco* marco, pdcrt_cache_de_mensaje* cache, int cid, int args, int rets)
+{
+    pdcrt_objeto marca = pdcrt_eliminar_elemento_en_pila(&marco->contexto->pila, args + 1);
+    pdcrt_objeto_debe_tener_tipo_tb(marco, marca, PDCRT_TOBJ_MARCA_DE_PILA);
+
+    pdcrt_marco* marco_superior = marco->marco_anterior;
+    pdcrt_texto* selector = marco_superior->contexto->constantes.textos[cid];
+    pdcrt_objeto obj = pdcrt_sacar_de_pila(&marco_superior->contexto->pila);
+    pdcrt_metodo metodo = pdcrt_buscar_metodo(cache, obj.recv, selector);
+    // Las continuaciones devueltas por el método ya son relativas a
+    // `marco_superior`, justo lo que necesita un envío "tail".
+    return (*metodo)(marco_superior, obj, pdcrt_objeto_desde_texto(selector), args, rets);
+}
+
 static size_t pdcrt_desvariadicear_argumentos(pdcrt_marco* marco, const unsigned char* proto, int args)
 {
     size_t total = 0;
@@ -4393,6 +6505,36 @@ pdcrt_continuacion pdcrt_op_tail_dynmsg(pdcrt_marco* marco, int args, int rets)
     return pdcrt_continuacion_tail_enviar_mensaje(marco_superior, obj, mensaje, args, rets);
 }
 
+pdcrt_continuacion pdcrt_op_dynmsg_cache(pdcrt_marco* marco, pdcrt_proc_continuacion proc, pdcrt_cache_de_mensaje* cache, int args, int rets)
+{
+    pdcrt_objeto mensaje = pdcrt_sacar_de_pila(&marco->contexto->pila);
+    pdcrt_objeto obj = pdcrt_sacar_de_pila(&marco->contexto->pila);
+    if(mensaje.tag != PDCRT_TOBJ_TEXTO)
+    {
+        // Deja que el receptor reporte el error.
+        return pdcrt_continuacion_enviar_mensaje(proc, marco, obj, mensaje, args, rets);
+    }
+    pdcrt_metodo metodo = pdcrt_buscar_metodo(cache, obj.recv, mensaje.value.t);
+    pdcrt_continuacion k = (*metodo)(marco, obj, mensaje, args, rets);
+    return pdcrt_continuar_tras_metodo(marco, proc, k);
+}
+
+pdcrt_continuacion pdcrt_op_tail_dynmsg_cache(pdcrt_marco* marco, pdcrt_cache_de_mensaje* cache, int args, int rets)
+{
+    pdcrt_objeto marca = pdcrt_eliminar_elemento_en_pila(&marco->contexto->pila, args + 1);
+    pdcrt_objeto_debe_tener_tipo_tb(marco, marca, PDCRT_TOBJ_MARCA_DE_PILA);
+
+    pdcrt_marco* marco_superior = marco->marco_anterior;
+    pdcrt_objeto mensaje = pdcrt_sacar_de_pila(&marco->contexto->pila);
+    pdcrt_objeto obj = pdcrt_sacar_de_pila(&marco_superior->contexto->pila);
+    if(mensaje.tag != PDCRT_TOBJ_TEXTO)
+    {
+        return pdcrt_continuacion_tail_enviar_mensaje(marco_superior, obj, mensaje, args, rets);
+    }
+    pdcrt_metodo metodo = pdcrt_buscar_metodo(cache, obj.recv, mensaje.value.t);
+    return (*metodo)(marco_superior, obj, mensaje, args, rets);
+}
+
 pdcrt_continuacion pdcrt_op_dynmsgv(pdcrt_marco* marco, pdcrt_proc_continuacion proc, const unsigned char* proto, int args, int rets)
 {
     pdcrt_objeto mensaje = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -4413,6 +6555,48 @@ pdcrt_continuacion pdcrt_op_tail_dynmsgv(pdcrt_marco* marco, const unsigned char
     return pdcrt_op_tail_dynmsg(marco, total, rets);
 }
 
+static bool pdcrt_es_llamada_propia(pdcrt_objeto obj, pdcrt_texto* selector, pdcrt_proc_t proc)
+{
+    return obj.recv == (pdcrt_funcion_generica) &pdcrt_recv_closure
+        && obj.value.c.proc == (pdcrt_funcion_generica) proc
+        && selector->selector == PDCRT_SEL_msj_llamar;
+}
+
+// Reinicia `marco` como si el trampolín lo hubiese destruido y vuelto a
+// iniciar para una nueva llamada a su procedimiento. La pila debe tener la
+// marca de pila de `marco`, los `args` argumentos y la closure en la cima.
+static void pdcrt_reiniciar_marco(pdcrt_marco* marco, int args, int rets, int nparams)
+{
+    pdcrt_objeto marca = pdcrt_eliminar_elemento_en_pila(&marco->contexto->pila, args + 1);
+    pdcrt_objeto_debe_tener_tipo_tb(marco, marca, PDCRT_TOBJ_MARCA_DE_PILA);
+    for(size_t i = 0; i < marco->num_locales; i++)
+    {
+        marco->locales[i] = pdcrt_objeto_nulo();
+    }
+    marco->num_valores_a_devolver = rets;
+    pdcrt_fijar_local(marco, PDCRT_ID_ESUP, pdcrt_ajustar_parametros(marco, args + 1, nparams, false));
+}
+
+bool pdcrt_op_tail_msg_propio(pdcrt_marco* marco, pdcrt_proc_t proc, int cid, int args, int rets, int nparams)
+{
+    pdcrt_objeto obj = pdcrt_cima_de_pila(&marco->contexto->pila);
+    if(!pdcrt_es_llamada_propia(obj, marco->contexto->constantes.textos[cid], proc))
+        return false;
+    pdcrt_reiniciar_marco(marco, args, rets, nparams);
+    return true;
+}
+
+bool pdcrt_op_tail_dynmsg_propio(pdcrt_marco* marco, pdcrt_proc_t proc, int args, int rets, int nparams)
+{
+    pdcrt_objeto mensaje = pdcrt_cima_de_pila(&marco->contexto->pila);
+    pdcrt_objeto obj = pdcrt_elemento_de_pila(&marco->contexto->pila, 1);
+    if(mensaje.tag != PDCRT_TOBJ_TEXTO || !pdcrt_es_llamada_propia(obj, mensaje.value.t, proc))
+        return false;
+    (void) pdcrt_sacar_de_pila(&marco->contexto->pila);
+    pdcrt_reiniciar_marco(marco, args, rets, nparams);
+    return true;
+}
+
 void pdcrt_op_spush(pdcrt_marco* marco, pdcrt_local_index eact, pdcrt_local_index esup)
 {
     pdcrt_objeto o_eact = pdcrt_obtener_local(marco, eact);
@@ -4517,6 +6701,7 @@ void pdcrt_op_exp(pdcrt_marco* marco, int idx, bool autoejec)
     pdcrt_objeto edn = pdcrt_cima_de_pila(&marco->contexto->pila);
     pdcrt_texto* nombre = marco->contexto->constantes.textos[idx];
     pdcrt_agregar_nombre_al_espacio_de_nombres(edn.value.e, nombre, autoejec, valor);
+    pdcrt_gc_write_barrier(marco->contexto, edn, valor);
 }
 
 pdcrt_continuacion pdcrt_op_import(pdcrt_marco* marco, int cid, pdcrt_proc_continuacion cont)
@@ -4604,7 +6789,7 @@ void pdcrt_op_getclsobj(pdcrt_marco* marco)
 
 pdcrt_continuacion pdcrt_frt_obtener_rt(pdcrt_marco* marco_actual, pdcrt_marco* marco_superior, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco_actual, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco_actual, marco_superior->contexto, marco_superior, rets);
     marco_actual->nombre = u8"__ObtenerRT";
     pdcrt_ajustar_argumentos_para_c(marco_actual->contexto, args, 1);
     (void) pdcrt_sacar_de_pila(&marco_actual->contexto->pila);
@@ -4685,18 +6870,20 @@ struct pdcrt_archivo* pdcrt_abrir_archivo(pdcrt_alojador alojador, pdcrt_texto*
 
 pdcrt_continuacion pdcrt_recv_rt(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de __RT";
     pdcrt_objeto_debe_tener_tipo_tb(marco, yo, PDCRT_TOBJ_VOIDPTR);
     pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
-    if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_argc))
+    switch(msj.value.t->selector)
+    {
+    case PDCRT_SEL_msj_argc:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_entero(marco->contexto->argc)));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_argv))
+    case PDCRT_SEL_msj_argv:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto i = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -4712,7 +6899,7 @@ pdcrt_continuacion pdcrt_recv_rt(struct pdcrt_marco* marco, struct pdcrt_marco*
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_fallarConMensaje))
+    case PDCRT_SEL_msj_fallarConMensaje:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto msj = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -4722,35 +6909,35 @@ pdcrt_continuacion pdcrt_recv_rt(struct pdcrt_marco* marco, struct pdcrt_marco*
         fprintf(stderr, "\n");
         pdcrt_abort();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_objeto))
+    case PDCRT_SEL_msj_objeto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, marco->contexto->claseObjeto));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_fijar_objeto))
+    case PDCRT_SEL_msj_fijar_objeto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         marco->contexto->claseObjeto = pdcrt_sacar_de_pila(&marco->contexto->pila);
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_entornoBootstrap))
+    case PDCRT_SEL_msj_entornoBootstrap:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, marco->contexto->entornoBootstrap));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_fijar_entornoBootstrap))
+    case PDCRT_SEL_msj_fijar_entornoBootstrap:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         marco->contexto->entornoBootstrap = pdcrt_sacar_de_pila(&marco->contexto->pila);
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_construirTexto))
+    case PDCRT_SEL_msj_construirTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         pdcrt_objeto arr = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -4778,7 +6965,7 @@ pdcrt_continuacion pdcrt_recv_rt(struct pdcrt_marco* marco, struct pdcrt_marco*
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_leerCaracter))
+    case PDCRT_SEL_msj_leerCaracter:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         int c = getchar();
@@ -4788,7 +6975,7 @@ pdcrt_continuacion pdcrt_recv_rt(struct pdcrt_marco* marco, struct pdcrt_marco*
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_abrirArchivo))
+    case PDCRT_SEL_msj_abrirArchivo:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 2);
         pdcrt_objeto modo = pdcrt_sacar_de_pila(&marco->contexto->pila);
@@ -4802,18 +6989,19 @@ pdcrt_continuacion pdcrt_recv_rt(struct pdcrt_marco* marco, struct pdcrt_marco*
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else
+    default:
     {
         printf("Mensaje ");
         pdcrt_escribir_texto(msj.value.t);
         printf(" no entendido para el objeto especial del runtime (__RT): %p\n", yo.value.p);
         pdcrt_abort();
     }
+    }
 }
 
 static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct pdcrt_marco* marco_superior, pdcrt_objeto yo, pdcrt_objeto msj, int args, int rets)
 {
-    no_falla(pdcrt_inic_marco(marco, marco_superior->contexto, 0, marco_superior, rets));
+    pdcrt_inic_marco_nativo(marco, marco_superior->contexto, marco_superior, rets);
     marco->nombre = u8"método de Archivo";
     pdcrt_objeto_debe_tener_tipo_tb(marco, yo, PDCRT_TOBJ_VOIDPTR);
     pdcrt_objeto_debe_tener_tipo_tb(marco, msj, PDCRT_TOBJ_TEXTO);
@@ -4826,17 +7014,20 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_abort();                                                  \
     }
 
-    if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_clonar))
+    switch(msj.value.t->selector)
+    {
+    case PDCRT_SEL_msj_clonar:
     {
         fprintf(stderr, "No se pueden clonar archivos %p\n", yo.value.p);
         pdcrt_abort();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_igualA) || pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.operador_igualA))
+    case PDCRT_SEL_msj_igualA:
+    case PDCRT_SEL_operador_igualA:
     {
         fprintf(stderr, "No se pueden comparar archivos %p\n", yo.value.p);
         pdcrt_abort();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_comoTexto))
+    case PDCRT_SEL_msj_comoTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
 #define PDCRT_LONGITUD_BUFFER 40
@@ -4850,14 +7041,14 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         return pdcrt_continuacion_devolver();
 #undef PDCRT_LONGITUD_BUFFER
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_estaAbierto))
+    case PDCRT_SEL_msj_estaAbierto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, pdcrt_objeto_booleano(archivo->archivo != NULL)));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_cerrar))
+    case PDCRT_SEL_msj_cerrar:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         if(archivo->archivo != NULL)
@@ -4868,7 +7059,7 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_leerByte))
+    case PDCRT_SEL_msj_leerByte:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         PDCRT_FALLA_SI_ESTA_CERRADO("leerByte");
@@ -4877,7 +7068,7 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_obtenerSiguienteByte))
+    case PDCRT_SEL_msj_obtenerSiguienteByte:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         PDCRT_FALLA_SI_ESTA_CERRADO("obtenerSiguienteByte");
@@ -4899,7 +7090,7 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_escribirByte))
+    case PDCRT_SEL_msj_escribirByte:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         PDCRT_FALLA_SI_ESTA_CERRADO("escribirByte");
@@ -4909,7 +7100,7 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_escribirTexto))
+    case PDCRT_SEL_msj_escribirTexto:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         PDCRT_FALLA_SI_ESTA_CERRADO("escribirTexto");
@@ -4919,7 +7110,7 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_posicionActual))
+    case PDCRT_SEL_msj_posicionActual:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         PDCRT_FALLA_SI_ESTA_CERRADO("posicionActual");
@@ -4930,7 +7121,7 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_cambiarPosicion))
+    case PDCRT_SEL_msj_cambiarPosicion:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 1);
         PDCRT_FALLA_SI_ESTA_CERRADO("cambiarPosicion");
@@ -4942,7 +7133,7 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 0);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_finDelArchivo))
+    case PDCRT_SEL_msj_finDelArchivo:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         PDCRT_FALLA_SI_ESTA_CERRADO("finDelArchivo");
@@ -4950,7 +7141,7 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_error))
+    case PDCRT_SEL_msj_error:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         PDCRT_FALLA_SI_ESTA_CERRADO("error");
@@ -4958,14 +7149,14 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_nombreDelArchivo))
+    case PDCRT_SEL_msj_nombreDelArchivo:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         no_falla(pdcrt_empujar_en_pila(&marco->contexto->pila, marco->contexto->alojador, archivo->nombre_del_archivo));
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj_modo))
+    case PDCRT_SEL_msj_modo:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         _Static_assert(sizeof(archivo->modo) <= sizeof(pdcrt_entero),
@@ -4974,20 +7165,21 @@ static pdcrt_continuacion pdcrt_recv_archivo(struct pdcrt_marco* marco, struct p
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else if(pdcrt_textos_son_iguales(msj.value.t, marco->contexto->constantes.msj___leerTodo))
+    case PDCRT_SEL_msj___leerTodo:
     {
         pdcrt_ajustar_argumentos_para_c(marco->contexto, args, 0);
         pdcrt_no_implementado("archivo#__leerTodo");
         pdcrt_ajustar_valores_devueltos_para_c(marco->contexto, rets, 1);
         return pdcrt_continuacion_devolver();
     }
-    else
+    default:
     {
         printf("Mensaje ");
         pdcrt_escribir_texto(msj.value.t);
         printf(" no entendido para el archivo: %p\n", yo.value.p);
         pdcrt_abort();
     }
+    }
 #undef PDCRT_FALLA_SI_ESTA_CERRADO
 }
 
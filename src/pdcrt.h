@@ -33,6 +33,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdbool.h>
@@ -63,6 +64,61 @@
 #define PDCRT_TIPO_REAL(ty)
 
 
+// Opciones del runtime.
+//
+// `PDCRT_OPT_LIMITE_DE_RECURSION`: El número máximo de llamadas anidadas (no
+// "tail") antes de que el runtime aborte con un error de "límite de recursión
+// alcanzado". Cada contexto copia este valor en `limite_de_recursion`, así que
+// también lo puedes cambiar en tiempo de ejecución.
+#ifndef PDCRT_OPT_LIMITE_DE_RECURSION
+#define PDCRT_OPT_LIMITE_DE_RECURSION 200000
+#endif
+
+// `PDCRT_OPT_GC_VIVERO`: El número de bytes que se pueden alojar entre dos
+// recolecciones de basura. También es el tamaño del vivero en el que se alojan
+// los objetos nuevos (ver `pdcrt_gc.vivero`). Se puede cambiar con la variable
+// de entorno `PDCRT_GC_VIVERO`.
+#ifndef PDCRT_OPT_GC_VIVERO
+#define PDCRT_OPT_GC_VIVERO (2 * 1024 * 1024)
+#endif
+
+// `PDCRT_OPT_GC_CRECIMIENTO`: Tras una recolección completa, la siguiente
+// recolección completa ocurrirá cuando el montículo crezca este número de
+// veces. Se puede cambiar con la variable de entorno `PDCRT_GC_CRECIMIENTO`.
+#ifndef PDCRT_OPT_GC_CRECIMIENTO
+#define PDCRT_OPT_GC_CRECIMIENTO 2.0
+#endif
+
+// `PDCRT_OPT_GC_MAXIMO`: El tamaño máximo (en bytes) del montículo. Si tras
+// una recolección completa el montículo aún es más grande el runtime aborta.
+// 0 significa que no hay límite. Se puede cambiar con la variable de entorno
+// `PDCRT_GC_MAXIMO`.
+#ifndef PDCRT_OPT_GC_MAXIMO
+#define PDCRT_OPT_GC_MAXIMO 0
+#endif
+
+// `PDCRT_OPT_GC_PASO`: Las recolecciones completas marcan y barren el
+// montículo poco a poco, en pasos intercalados con la ejecución del
+// programa. Cada paso de marcado recorre a lo más este número de objetos y de
+// referencias (un arreglo cuenta como uno más su longitud) y cada paso de
+// barrido a lo más este número de ranuras. 0 hace que las recolecciones
+// completas marquen y barran todo el montículo de una vez. Se puede cambiar
+// con la variable de entorno `PDCRT_GC_PASO`.
+#ifndef PDCRT_OPT_GC_PASO
+#define PDCRT_OPT_GC_PASO 10000
+#endif
+
+// `PDCRT_OPT_GC_HILOS`: El número de hilos que marcan el montículo al final de
+// las recolecciones completas. Con 0 el runtime no usa hilos (ni necesita
+// `<threads.h>`). Con otro valor el runtime puede usar hasta ese número de
+// hilos, pero solo si el montículo es lo suficientemente grande (ver
+// `PDCRT_GC_MIN_MARCADO_PARALELO`). Se puede cambiar con la variable de entorno
+// `PDCRT_GC_HILOS`, pero solo si este valor no es 0.
+#ifndef PDCRT_OPT_GC_HILOS
+#define PDCRT_OPT_GC_HILOS 0
+#endif
+
+
 // Macros de depuración.
 //
 // Las siguientes macros activan distintos sistemas de depuración del
@@ -86,6 +142,9 @@
 // `PDCRT_DBG_GC`: Escribe estadísticas del recolector de basura cada vez que
 // se invoque.
 //
+// `PDCRT_DBG_ESTADISTICAS_DE_LAS_CACHES`: Al destruir un contexto, escribe
+// los aciertos y fallos de las cachés de métodos de cada sitio de envío.
+//
 // `PDCRT_DBG_NO_BUILTINS`: Provee implementaciones vacías de los builtins.
 //
 // `PDCRT_DBG`: Activa la mayoría de las opciones anteriores.
@@ -96,6 +155,7 @@
 #define PDCRT_DBG_ESCRIBIR_ERRORES
 #define PDCRT_DBG_RASTREAR_CONTEXTO
 #define PDCRT_DBG_GC
+#define PDCRT_DBG_ESTADISTICAS_DE_LAS_CACHES
 #endif
 
 // Las macros PRB (de "prueba").
@@ -219,7 +279,9 @@ pdcrt_alojador pdcrt_alojador_de_malloc(void);
 // Un alojador grupal. A medida que se aloja memoria en el, este solo la
 // acumula hasta que al final, cuando se llame a
 // `pdcrt_dealoj_alojador_de_arena` toda la memoria que fue alojada será
-// desalojada.
+// desalojada. Los bloques se toman uno tras otro de trozos grandes, así que
+// alojar cuesta lo mismo que mover un puntero. Solo el último bloque alojado
+// puede crecer sin copiarse o devolver su memoria antes de tiempo.
 //
 // Nota: el nombre de esta función está mal, debido a un descuido de mi parte,
 // se llama `pdcrt_aloj_alojador_de_arena` en vez de
@@ -238,6 +300,7 @@ struct pdcrt_contexto;
 struct pdcrt_objeto;
 struct pdcrt_marco;
 struct pdcrt_env;
+struct pdcrt_arreglo;
 
 
 // Recolector de basura:
@@ -250,51 +313,204 @@ typedef enum pdcrt_tipo_objeto_gc
     PDCRT_GC_ENV
 } pdcrt_tipo_objeto_gc;
 
-#define PDCRT_MAX_GENERACION 536870911uL
-
+// Todo objeto recolectable empieza con esta cabecera.
+//
+// Los objetos viven en las "ranuras" de una página del montículo (ver
+// `pdcrt_pagina_gc`). Sus bits de marcado, de ocupación y de generación
+// están en las páginas y no en el objeto, así que la cabecera solo indica
+// dónde encontrarlos. Los objetos nuevos pueden vivir en el vivero (ver
+// `pdcrt_gc.vivero`), en cuyo caso `pagina` es `PDCRT_GC_PAGINA_DEL_VIVERO`.
 typedef struct pdcrt_cabecera_gc
 {
-    bool joven : 1;
-    unsigned generacion : 29;
+    // El índice de la página que contiene al objeto en `pdcrt_gc.paginas`.
+    uint32_t pagina;
+    // El índice de la ranura del objeto en su página. En el vivero es
+    // `PDCRT_GC_RANURA_REENVIADA` si el objeto ya fue copiado a una página.
+    uint16_t ranura;
     pdcrt_tipo_objeto_gc tipo : 2;
-    struct pdcrt_cabecera_gc* siguiente;
-    struct pdcrt_cabecera_gc* anterior;
+    // Si el objeto está en el conjunto recordado (ver
+    // `pdcrt_gc.recordados`).
+    bool recordado : 1;
 } pdcrt_cabecera_gc;
 
 size_t pdcrt_tam_de_objeto(pdcrt_cabecera_gc* obj);
 
 #define PDCRT_CABECERA_GC() pdcrt_cabecera_gc gc
 
-typedef struct pdcrt_lista_de_objetos
+// El tamaño (en bytes) del espacio para los objetos de una página.
+#define PDCRT_GC_TAM_PAGINA 16384
+// El tamaño de la ranura más pequeña. Ninguna clase de tamaño puede tener
+// ranuras más pequeñas que esto.
+#define PDCRT_GC_TAM_MIN_RANURA 32
+// El número de palabras de 64 bits en cada mapa de bits de una página.
+#define PDCRT_GC_PALABRAS_POR_MAPA (PDCRT_GC_TAM_PAGINA / PDCRT_GC_TAM_MIN_RANURA / 64)
+// El número de elementos de un arreglo que cubre cada una de sus tarjetas.
+#define PDCRT_GC_ELEMENTOS_POR_TARJETA 64
+// Mientras se marca en pasos, el número de pasos de marcado que se dan por
+// cada vivero alojado.
+#define PDCRT_GC_PASOS_POR_VIVERO 16
+// El tamaño (en bytes) que debe tener el montículo para que valga la pena
+// marcarlo con varios hilos (ver `PDCRT_OPT_GC_HILOS`).
+#define PDCRT_GC_MIN_MARCADO_PARALELO (4 * 1024 * 1024)
+// El tamaño (en bytes) a partir del cual un bloque es parte del espacio de
+// objetos grandes: con `PDCRT_OPT_GNU` se aloja directamente con `mmap`, crece
+// sin copiarse y se le devuelve al sistema operativo al liberarse.
+#define PDCRT_GC_TAM_BLOQUE_GRANDE (128 * 1024)
+// El valor de `pdcrt_cabecera_gc.pagina` de los objetos que están en el
+// vivero.
+#define PDCRT_GC_PAGINA_DEL_VIVERO UINT32_MAX
+// El valor de `pdcrt_cabecera_gc.ranura` de los objetos del vivero que ya
+// fueron copiados a una página.
+#define PDCRT_GC_RANURA_REENVIADA 1
+
+// Un objeto del vivero que ya fue copiado a una página. `destino` es la copia.
+typedef struct pdcrt_objeto_reenviado
 {
-    pdcrt_cabecera_gc* primero;
-    pdcrt_cabecera_gc* ultimo;
-} pdcrt_lista_de_objetos;
-
-void pdcrt_agregar_a_la_lista(pdcrt_lista_de_objetos* lista, pdcrt_cabecera_gc* obj);
-void pdcrt_eliminar_de_la_lista(pdcrt_lista_de_objetos* lista, pdcrt_cabecera_gc* obj);
+    pdcrt_cabecera_gc gc;
+    pdcrt_cabecera_gc* destino;
+} pdcrt_objeto_reenviado;
+
+// El número de clases de tamaño: una para los textos, otra para los espacios
+// de nombres, otra para los arreglos y 11 para los entornos (según su número
+// de variables).
+#define PDCRT_GC_NUM_CLASES 14
+// La "clase" de las páginas que contienen un solo objeto demasiado grande
+// para cualquier clase de tamaño.
+#define PDCRT_GC_CLASE_GRANDE PDCRT_GC_NUM_CLASES
+
+// Una página del montículo.
+//
+// Cada página contiene objetos de una sola clase de tamaño (y por lo tanto de
+// un solo tipo), así que todas sus ranuras son del mismo tamaño. El estado de
+// cada ranura está en 3 mapas de bits: `ocupadas` (si la ranura contiene un
+// objeto), `marcadas` (si el objeto fue alcanzado durante la recolección
+// actual) y `jovenes` (si el objeto está en la primera generación). Barrer
+// una página son solo operaciones sobre estos mapas.
+typedef struct pdcrt_pagina_gc
+{
+    // La siguiente página de la misma clase con ranuras libres.
+    struct pdcrt_pagina_gc* siguiente_con_espacio;
+    size_t tam_ranura;
+    size_t num_ranuras;
+    size_t num_ocupadas;
+    // El tamaño total de la página, incluyendo esta cabecera.
+    size_t tam_total;
+    uint32_t indice;
+    unsigned int clase;
+    pdcrt_tipo_objeto_gc tipo;
+    bool tiene_jovenes;
+    bool con_espacio;
+    // Si la página todavía no se ha barrido tras la última recolección
+    // completa (ver `pdcrt_gc.por_barrer`).
+    bool por_barrer;
+    uint64_t ocupadas[PDCRT_GC_PALABRAS_POR_MAPA];
+    uint64_t marcadas[PDCRT_GC_PALABRAS_POR_MAPA];
+    uint64_t jovenes[PDCRT_GC_PALABRAS_POR_MAPA];
+    _Alignas(max_align_t) unsigned char ranuras[];
+} pdcrt_pagina_gc;
+
+// Una pila de objetos grises (ver `pdcrt_gc.grises`). Si no puede crecer,
+// `desbordada` se vuelve true y el recolector termina de marcar recorriendo
+// el montículo.
+typedef struct pdcrt_pila_de_grises
+{
+    pdcrt_cabecera_gc** elementos;
+    size_t num_elementos;
+    size_t capacidad;
+    bool desbordada;
+} pdcrt_pila_de_grises;
 
 typedef struct pdcrt_gc
 {
     pdcrt_alojador alojador;
     pdcrt_alojador alojador_original;
-    // Lista con los objetos jovenes (primera generación)
-    pdcrt_lista_de_objetos objetos_jovenes;
-    // Lista con los objetos viejos (segunda generación)
-    pdcrt_lista_de_objetos objetos_viejos;
+    // Todas las páginas del montículo. Las páginas liberadas dejan un `NULL`
+    // que puede ser reusado por una nueva página.
+    pdcrt_pagina_gc** paginas;
+    size_t num_paginas;
+    size_t cap_paginas;
+    size_t num_huecos;
+    // Para cada clase de tamaño, la lista de sus páginas con ranuras libres.
+    pdcrt_pagina_gc* con_espacio[PDCRT_GC_NUM_CLASES];
     // Para poder saber que objetos jovenes están vivos, es necesario mantener
-    // una lista de objetos viejos que contienen objetos jovenes. Todos los
-    // objetos jovenes alcanzables mediante esta lista son considerados vivos.
+    // un conjunto de objetos viejos que contienen objetos jovenes. Todos los
+    // objetos jovenes alcanzables mediante este conjunto son considerados
+    // vivos.
     //
-    // En teoría esta lista es innecesaria ya que podríamos escanear la lista
-    // de los objetos viejos, pero esto sería muy lento. En cambio, todos los
+    // En teoría este conjunto es innecesario ya que podríamos escanear todos
+    // los objetos viejos, pero esto sería muy lento. En cambio, todos los
     // lugares en los que se fija un atributo de un objeto tienen un «write
-    // barrier» que agrega al objeto a esta lista si el valor es joven.
-    pdcrt_lista_de_objetos objetos_viejos_que_contienen_a_uno_joven;
+    // barrier» que agrega al objeto a este conjunto si el valor es joven.
+    //
+    // Los arreglos grandes tienen además tarjetas (ver
+    // `pdcrt_arreglo.tarjetas`): de ellos solo se recorren las tarjetas
+    // sucias. Estos arreglos se quedan en el conjunto entre recolecciones.
+    pdcrt_cabecera_gc** recordados;
+    size_t num_recordados;
+    size_t cap_recordados;
+    // La pila de objetos grises: objetos marcados cuyos hijos todavía no se
+    // han marcado.
+    pdcrt_pila_de_grises grises;
+    // Si `marcando` es true hay una recolección completa en curso (ver
+    // `PDCRT_OPT_GC_PASO`): los objetos viejos marcados hasta ahora están
+    // en `grises_viejos` o ya fueron recorridos. Mientras tanto las
+    // recolecciones de la primera generación no borran las marcas de los
+    // objetos viejos, los sobrevivientes que promueven quedan marcados y los
+    // write barriers marcan todo objeto viejo que se guarde en otro (así un
+    // objeto recorrido nunca apunta a uno sin marcar).
+    bool marcando;
+    pdcrt_pila_de_grises grises_viejos;
+    // El siguiente paso del marcado (o del barrido) ocurre cuando `alojados`
+    // llegue a `proximo_paso`.
+    size_t proximo_paso;
+    // Tras una recolección completa las páginas no se barren de una vez: se
+    // barren cuando se necesita una ranura de su clase o en pasos, igual que
+    // el marcado. `por_barrer` es el número de páginas que faltan por barrer,
+    // que están todas a partir de `paginas[cursor_de_barrido]`. Mientras
+    // tanto las recolecciones de la primera generación no borran las marcas
+    // de los objetos viejos: los que no están marcados en esas páginas son
+    // basura.
+    size_t por_barrer;
+    size_t cursor_de_barrido;
+    // El vivero es un bloque contiguo de `tam_vivero` bytes en el que se
+    // alojan los entornos, arreglos y espacios de nombres nuevos (los textos
+    // siempre van a las páginas) solo incrementando `vivero_libre`. En cada
+    // recolección los objetos vivos del vivero se copian a las páginas como
+    // objetos viejos y el vivero se vacía, así que recolectarlo cuesta lo
+    // mismo que sus objetos vivos. Si el vivero se llena antes de la
+    // siguiente recolección los objetos nuevos se alojan en las páginas.
+    PDCRT_NULL unsigned char* vivero;
+    PDCRT_NULL unsigned char* vivero_libre;
+    PDCRT_NULL unsigned char* vivero_fin;
+    size_t num_en_vivero;
+    // Los objetos del vivero que alojan algo fuera de él (arreglos y espacios
+    // de nombres): si mueren hay que desalojar su contenido.
+    pdcrt_cabecera_gc** con_contenido;
+    size_t num_con_contenido;
+    size_t cap_con_contenido;
+    // El número de bytes usados por el montículo y por lo que sus objetos
+    // alojan fuera de este.
     long long usado;
+    // Los bytes de `usado` que están en el espacio de objetos grandes (ver
+    // `PDCRT_GC_TAM_BLOQUE_GRANDE`). No cuentan en `alojados`.
+    size_t usado_grande;
     size_t num_objetos;
-    size_t cnt;
-    size_t mcnt;
+    // El número de bytes alojados desde la última recolección. Ver
+    // `pdcrt_deberia_recolectar_basura`.
+    size_t alojados;
+    // Cuando `usado` llega a este número la siguiente recolección es
+    // completa en vez de ser solo de la primera generación.
+    long long limite_completa;
+    // El número de recolecciones que se han hecho. Ver `pdcrt_marco.ciclo_gc`.
+    size_t ciclo;
+    // El ritmo del recolector. Ver `PDCRT_OPT_GC_VIVERO`,
+    // `PDCRT_OPT_GC_CRECIMIENTO`, `PDCRT_OPT_GC_MAXIMO`, `PDCRT_OPT_GC_PASO`
+    // y `PDCRT_OPT_GC_HILOS`.
+    size_t tam_vivero;
+    double crecimiento;
+    size_t maximo;
+    size_t paso;
+    size_t hilos;
 } pdcrt_gc;
 
 pdcrt_error pdcrt_inic_gc(PDCRT_OUT pdcrt_gc* gc, pdcrt_alojador aloj);
@@ -302,18 +518,35 @@ void pdcrt_deinic_gc(pdcrt_gc* gc);
 
 void pdcrt_gc_marcar_como_que_contiene_joven(pdcrt_gc* gc, pdcrt_cabecera_gc* obj);
 void pdcrt_gc_write_barrier(struct pdcrt_contexto* ctx, struct pdcrt_objeto cont, struct pdcrt_objeto val);
+// Igual a `pdcrt_gc_write_barrier`, pero para cuando se fija el elemento
+// `indice` del arreglo `arr`.
+void pdcrt_gc_write_barrier_en_arreglo(struct pdcrt_contexto* ctx, struct pdcrt_arreglo* arr, size_t indice, struct pdcrt_objeto val);
 
+// Aloja un objeto de `sz` bytes y tipo `tipo` en el montículo. El objeto
+// puede moverse en la siguiente recolección: no guardes punteros a él fuera
+// de un `pdcrt_objeto` alcanzable por el recolector.
 pdcrt_cabecera_gc* pdcrt_gc_alojar(pdcrt_gc* gc, size_t sz, pdcrt_tipo_objeto_gc tipo);
+// Libera la ranura de `obj` sin desalojar su contenido. Solo debe usarse si
+// la inicialización del objeto falló.
 void pdcrt_gc_olvidar(pdcrt_gc* gc, pdcrt_cabecera_gc* obj);
+// Desaloja el contenido de `obj` y libera su ranura.
 void pdcrt_gc_dealojar(pdcrt_gc* gc, pdcrt_cabecera_gc* obj);
 
-struct pdcrt_continuacion;
-void pdcrt_recolectar_basura(PDCRT_ARR(num_marcos) struct pdcrt_marco* marcos,
-                             size_t num_marcos,
-                             struct pdcrt_marco* marco,
-                             PDCRT_ARR(num_cont) struct pdcrt_continuacion* continuaciones,
-                             size_t num_cont);
-
+struct pdcrt_pila_de_continuaciones;
+// Recolecta la basura. `marco` es el marco actual y `pila` la pila de
+// continuaciones del trampolín.
+void pdcrt_recolectar_basura(struct pdcrt_pila_de_continuaciones* pila, struct pdcrt_marco* marco);
+
+// Configura el ritmo del recolector con las variables de entorno
+// `PDCRT_GC_VIVERO`, `PDCRT_GC_CRECIMIENTO`, `PDCRT_GC_MAXIMO`,
+// `PDCRT_GC_PASO` y `PDCRT_GC_HILOS`. Termina el programa si alguna tiene un
+// valor inválido.
+void pdcrt_gc_configurar_desde_el_entorno(pdcrt_gc* gc);
+
+// Determina si se debería recolectar la basura. Es barata: solo compara el
+// número de bytes alojados desde la última recolección con `tam_vivero` (y con
+// `proximo_paso` si hay una recolección completa o un barrido en curso) y el
+// tamaño del montículo con `limite_completa`.
 bool pdcrt_deberia_recolectar_basura(pdcrt_gc* gc);
 
 
@@ -354,6 +587,115 @@ typedef struct pdcrt_closure
     struct pdcrt_env* env;
 } pdcrt_closure;
 
+// Tabla de textos predefinidos.
+//
+// Cada entrada `M(campo, literal)` corresponde a un campo `campo` de
+// `pdcrt_constantes` (ver más abajo) que contiene al texto `literal`. La
+// mayoría de estos textos son los mensajes que entienden los objetos
+// predefinidos del runtime.
+#define PDCRT_TABLA_DE_TEXTOS(M)                                        \
+    M(operador_mas, "operador_+")                                       \
+    M(operador_menos, "operador_-")                                     \
+    M(operador_por, "operador_*")                                       \
+    M(operador_entre, "operador_/")                                     \
+    M(operador_menorQue, "operador_<")                                  \
+    M(operador_menorOIgualA, "operador_=<")                             \
+    M(operador_mayorQue, "operador_>")                                  \
+    M(operador_mayorOIgualA, "operador_>=")                             \
+    M(operador_igualA, "operador_=")                                    \
+    M(operador_noIgualA, "operador_no=")                                \
+    M(operador_y, "operador_&&")                                        \
+    M(operador_o, "operador_||")                                        \
+    M(msj_sumar, "sumar")                                               \
+    M(msj_restar, "restar")                                             \
+    M(msj_multiplicar, "multiplicar")                                   \
+    M(msj_dividir, "dividir")                                           \
+    M(msj_menorQue, "menorQue")                                         \
+    M(msj_mayorQue, "mayorQue")                                         \
+    M(msj_menorOIgualA, "menorOIgualA")                                 \
+    M(msj_mayorOIgualA, "mayorOIgualA")                                 \
+    M(msj_igualA, "igualA")                                             \
+    M(msj_distintoDe, u8"distíntoDe")                                   \
+    M(msj_clonar, "clonar")                                             \
+    M(msj_llamar, "llamar")                                             \
+    M(msj_comoTexto, "comoTexto")                                       \
+    M(msj_negar, "negar")                                               \
+    M(msj_truncar, "truncar")                                           \
+    M(msj_piso, "piso")                                                 \
+    M(msj_techo, "techo")                                               \
+    M(msj_comoByteEnTexto, "comoByteEnTexto")                           \
+    M(msj_hashPara, "hashPara")                                         \
+    M(msj_longitud, "longitud")                                         \
+    M(msj_comoNumeroEntero, "comoNumeroEntero")                         \
+    M(msj_comoNumeroReal, "comoNumeroReal")                             \
+    M(msj_en, "en")                                                     \
+    M(msj_fijarEn, "fijarEn")                                           \
+    M(msj_concatenar, "concatenar")                                     \
+    M(msj_parteDelTexto, "parteDelTexto")                               \
+    M(msj_subTexto, "subTexto")                                         \
+    M(msj_buscar, "buscar")                                             \
+    M(msj_buscarEnReversa, "buscarEnReversa")                           \
+    M(msj_formatear, "formatear")                                       \
+    M(msj_byteEn, "byteEn")                                             \
+    M(msj_comoObjeto, "comoObjeto")                                     \
+    M(msj___codigoIgualA, u8"__códigoIgualA")                           \
+    M(msj___entornoIgualA, "__entornoIgualA")                           \
+    M(msj_escojer, "escojer")                                           \
+    M(msj_llamarSegun, "llamarSegun")                                   \
+    M(msj_y, "y")                                                       \
+    M(msj_o, "o")                                                       \
+    M(msj_agregarAlFinal, "agregarAlFinal")                             \
+    M(msj_redimensionar, "redimensionar")                               \
+    M(msj_entornoBootstrap, "entornoBootstrap")                         \
+    M(msj_fijar_entornoBootstrap, "fijar_entornoBootstrap")             \
+    M(msj_leerCaracter, "leerCaracter")                                 \
+    M(msj_abrirArchivo, "abrirArchivo")                                 \
+    M(msj_construirTexto, "construirTexto")                             \
+    M(msj_estaAbierto, "estaAbierto")                                   \
+    M(msj_leerByte, "leerByte")                                         \
+    M(msj_cerrar, "cerrar")                                             \
+    M(msj_obtenerSiguienteByte, "obtenerSiguienteByte")                 \
+    M(msj_escribirByte, "escribirByte")                                 \
+    M(msj_escribirTexto, "escribirTexto")                               \
+    M(msj_posicionActual, "posicionActual")                             \
+    M(msj_cambiarPosicion, "cambiarPosicion")                           \
+    M(msj_finDelArchivo, "finDelArchivo")                               \
+    M(msj_error, "error")                                               \
+    M(msj_nombreDelArchivo, "nombreDelArchivo")                         \
+    M(msj_modo, "modo")                                                 \
+    M(msj___leerTodo, "__leerTodo")                                     \
+    M(msj_mapear, "mapear")                                             \
+    M(msj_reducir, "reducir")                                           \
+    M(msj_argc, "argc")                                                 \
+    M(msj_argv, "argv")                                                 \
+    M(msj_fallarConMensaje, "fallarConMensaje")                         \
+    M(msj_objeto, "objeto")                                             \
+    M(msj_fijar_objeto, "fijar_objeto")                                 \
+    M(txt_verdadero, "VERDADERO")                                       \
+    M(txt_falso, "FALSO")                                               \
+    M(txt_nulo, "NULO")
+
+// Selectores.
+//
+// Todos los textos de `PDCRT_TABLA_DE_TEXTOS` tienen un "selector": un entero
+// pequeño y único que se guarda en el campo `selector` del texto. Como los
+// textos están internados (ver `pdcrt_textos`), un mensaje tiene el mismo
+// selector sin importar cómo fue creado. Esto permite que los métodos de los
+// objetos predefinidos (`pdcrt_recv_numero`, `pdcrt_recv_texto`, etc) escojan
+// la rama a ejecutar con un `switch` (que el compilador traduce a una tabla de
+// saltos) en vez de comparar el mensaje contra cada texto uno por uno.
+//
+// Los textos que no están en la tabla tienen el selector
+// `PDCRT_SEL_NINGUNO`.
+typedef enum pdcrt_selector
+{
+    PDCRT_SEL_NINGUNO = 0,
+#define PDCRT_DECLARAR_SELECTOR(cm, _lit) PDCRT_SEL_##cm,
+    PDCRT_TABLA_DE_TEXTOS(PDCRT_DECLARAR_SELECTOR)
+#undef PDCRT_DECLARAR_SELECTOR
+    PDCRT_NUM_SELECTORES
+} pdcrt_selector;
+
 // Un texto.
 //
 // Contiene cero o más carácteres codificados con UTF-8 en `contenido`. Estos
@@ -367,6 +709,9 @@ typedef struct pdcrt_closure
 //
 // Como caso especial, un texto vacío puede tener `NULL` como `contenido`.
 //
+// `selector` es `PDCRT_SEL_NINGUNO` excepto para los textos de
+// `PDCRT_TABLA_DE_TEXTOS`. Ver `pdcrt_selector`.
+//
 // Los textos "poseen" su contenido. Este es alojado y desalojado junto al
 // texto.
 typedef struct pdcrt_texto
@@ -374,6 +719,13 @@ typedef struct pdcrt_texto
     PDCRT_CABECERA_GC();
     PDCRT_NULL PDCRT_ARR(longitud) char* contenido;
     size_t longitud;
+    pdcrt_selector selector;
+    // El hash del contenido, o 0 si todavía no ha sido calculado. Ver
+    // `pdcrt_hash_de_texto`.
+    uint64_t hash;
+    // Si el texto fue usado alguna vez como selector en una caché de métodos.
+    // Solo hace falta vaciar las cachés cuando muere uno de estos textos.
+    bool en_cache;
 } pdcrt_texto;
 
 // Aloja un texto con un contenido indeterminado pero de tamaño `lon`.
@@ -381,7 +733,8 @@ pdcrt_error pdcrt_aloj_texto(PDCRT_OUT pdcrt_texto** texto, pdcrt_gc* gc, size_t
 // Aloja un texto con el mismo contenido y tamaño que el C-string `cstr` (que
 // debe terminar con el byte nulo). El texto alojado no tendrá el byte nulo.
 pdcrt_error pdcrt_aloj_texto_desde_c(PDCRT_OUT pdcrt_texto** texto, pdcrt_gc* gc, const char* cstr);
-// Desaloja un texto.
+// Desaloja el contenido de un texto. El texto mismo vive en el montículo del
+// recolector y es liberado por este.
 void pdcrt_dealoj_texto(pdcrt_alojador alojador, pdcrt_texto* texto);
 // Determina si dos textos son iguales.
 bool pdcrt_textos_son_iguales(pdcrt_texto* a, pdcrt_texto* b);
@@ -408,7 +761,7 @@ typedef unsigned long pdcrt_uentero;
 
 typedef double pdcrt_float;
 #define PDCRT_FLOAT_FMT "%f"
-#define PDCRT_FLOAT_ATR(name) FLT_##name
+#define PDCRT_FLOAT_ATR(name) DBL_##name
 #define PDCRT_FLOAT_DIG_SIG PDCRT_FLOAT_ATR(MANT_DIG)
 #define PDCRT_FLOAT_FREXP(x, exp) frexp(x, exp)
 #define PDCRT_FLOAT_MODF(x, fr) modf(x, fr)
@@ -529,8 +882,9 @@ typedef struct pdcrt_edn_triple
 // cualquiera de estos antes de agregarlos caurará un *comportamiento
 // indefinído*.
 pdcrt_error pdcrt_aloj_espacio_de_nombres(pdcrt_gc* gc, PDCRT_OUT pdcrt_espacio_de_nombres** espacio, size_t num);
-// Desaloja un espacio de nombres. No desaloja los textos ni los objetos
-// contenidos en los triples de dicho espacio.
+// Desaloja los nombres de un espacio de nombres (el espacio mismo es liberado
+// por el recolector). No desaloja los textos ni los objetos contenidos en los
+// triples de dicho espacio.
 void pdcrt_dealoj_espacio_de_nombres(pdcrt_alojador alojador, pdcrt_espacio_de_nombres* espacio);
 // Agrega un nombre al espacio de nombres.
 //
@@ -561,11 +915,20 @@ typedef struct pdcrt_arreglo
     PDCRT_ARR(capacidad) pdcrt_objeto* elementos;
     size_t capacidad;
     size_t longitud;
+    // Las tarjetas del arreglo: `tarjetas[i]` es distinto de 0 si algún
+    // elemento entre `i * PDCRT_GC_ELEMENTOS_POR_TARJETA` y `(i + 1) *
+    // PDCRT_GC_ELEMENTOS_POR_TARJETA` pudo recibir un objeto joven desde la
+    // última recolección. Solo los arreglos viejos y grandes tienen tarjetas
+    // (ver `pdcrt_gc_write_barrier_en_arreglo`); los elementos a partir de
+    // `num_tarjetas * PDCRT_GC_ELEMENTOS_POR_TARJETA` siempre se recorren.
+    PDCRT_NULL PDCRT_ARR(num_tarjetas) uint8_t* tarjetas;
+    size_t num_tarjetas;
 } pdcrt_arreglo;
 
 // Aloja un nuevo arreglo con una capacidad dada. Su longitud es de 0.
 pdcrt_error pdcrt_aloj_arreglo(pdcrt_gc* gc, PDCRT_OUT pdcrt_arreglo** arr, size_t capacidad);
-// Desaloja un arreglo.
+// Desaloja los elementos de un arreglo (el arreglo mismo es liberado por el
+// recolector).
 void pdcrt_dealoj_arreglo(pdcrt_alojador alojador, pdcrt_arreglo* arr);
 
 // Aloja y devuelve un arreglo vacío.
@@ -640,9 +1003,21 @@ pdcrt_error pdcrt_arreglo_mover_elementos(
 
 
 // Hashea un objeto. Solo puede hashear enteros, floats, nulos, textos, marcas
-// de pila, booleanos y voidptrs.
+// de pila, booleanos y voidptrs. El resultado está entre 0 y `n - 1` y se
+// obtiene de `pdcrt_hash_de_objeto`. `n` no puede ser 0.
 pdcrt_entero pdcrt_hashear_objeto(pdcrt_objeto obj, pdcrt_uentero n);
 
+// Calcula el hash de 64 bits de un objeto. Los floats con valor entero tienen
+// el mismo hash que el entero correspondiente.
+uint64_t pdcrt_hash_de_objeto(pdcrt_objeto obj);
+
+// Calcula un hash de 64 bits de `longitud` bytes. Está basado en wyhash.
+uint64_t pdcrt_hash_de_bytes(const void* bytes, size_t longitud);
+
+// Devuelve el hash del contenido de `texto`. Solo se calcula la primera vez:
+// después se guarda en el texto. Nunca es 0 ni 1.
+uint64_t pdcrt_hash_de_texto(pdcrt_texto* texto);
+
 
 // Una continuación.
 //
@@ -889,6 +1264,67 @@ typedef pdcrt_continuacion (*pdcrt_recvmsj)(struct pdcrt_marco* marco,
 // de esta macro es pública y puedes usarla libremente en tus programas.
 #define PDCRT_CONV_RECV(recv_gen) ((pdcrt_recvmsj) (recv_gen))
 
+// Un método es lo que se obtiene al resolver un par (receptor, selector).
+//
+// A diferencia de `pdcrt_recvmsj`, un método no tiene un marco propio: se
+// ejecuta directamente sobre `marco_superior` (el marco del que envía el
+// mensaje) y devuelve una continuación como la de un receptor, es decir:
+// `PDCRT_CONT_DEVOLVER` si ya dejó sus `rets` valores en la pila o alguna de
+// las continuaciones "tail" relativas a `marco_superior`.
+typedef pdcrt_continuacion (*pdcrt_metodo)(struct pdcrt_marco* marco_superior,
+                                           pdcrt_objeto yo,
+                                           pdcrt_objeto msj,
+                                           int args,
+                                           int rets);
+
+// Número de entradas de la caché polimórfica de cada sitio de envío.
+#define PDCRT_TAM_CACHE_POLIMORFICA 4
+
+typedef struct pdcrt_entrada_de_cache
+{
+    PDCRT_TIPO_REAL(pdcrt_recvmsj) pdcrt_funcion_generica recv;
+    pdcrt_texto* selector;
+    pdcrt_metodo metodo;
+} pdcrt_entrada_de_cache;
+
+// Caché polimórfica de un sitio de envío de mensajes (`MSG`, `TMSG`, `DYNMSG`
+// y `TDYNMSG`).
+//
+// El compilador emite una de estas (estática) por cada sitio. Guarda los
+// últimos `PDCRT_TAM_CACHE_POLIMORFICA` pares (receptor, selector) vistos en
+// el sitio junto con los métodos a los que se resolvieron. Mientras el par
+// esté en la caché, el envío llama directamente al método sin pasar por el
+// trampolín.
+//
+// Cuando la caché se llena el sitio se vuelve "megamórfico" y los fallos se
+// buscan en la caché global (compartida por todos los sitios) antes de
+// resolver el método.
+//
+// `aciertos` y `fallos` cuentan los envíos que encontraron (o no) su método
+// en esta caché. `sitio` es un nombre legible del sitio (puede ser `NULL`) y
+// `siguiente` enlaza todas las cachés que se han usado al menos una vez (ver
+// `pdcrt_escribir_estadisticas_de_las_caches`).
+typedef struct pdcrt_cache_de_mensaje
+{
+    pdcrt_entrada_de_cache entradas[PDCRT_TAM_CACHE_POLIMORFICA];
+    size_t num_entradas;
+    bool megamorfico;
+    bool registrado;
+    size_t aciertos;
+    size_t fallos;
+    PDCRT_NULL const char* sitio;
+    PDCRT_NULL struct pdcrt_cache_de_mensaje* siguiente;
+} pdcrt_cache_de_mensaje;
+
+// Escribe a `out` los contadores de la caché global y de cada sitio de envío
+// usado hasta ahora.
+void pdcrt_escribir_estadisticas_de_las_caches(FILE* out);
+
+// Resuelve el par (receptor, selector) a un método. Nunca devuelve `NULL`: si
+// el receptor no es conocido, devuelve un método que simplemente envía el
+// mensaje de forma genérica.
+pdcrt_metodo pdcrt_resolver_metodo(pdcrt_funcion_generica recv, pdcrt_texto* selector);
+
 // Locales especiales.
 //
 // Algunas variables locales de PseudoD son especiales porque se definen en el
@@ -945,12 +1381,12 @@ typedef struct pdcrt_env
 // de `PDCRT_ID_*`.
 typedef long pdcrt_local_index;
 
-// Aloja y desaloja un entorno.
+// Aloja un entorno. Los entornos no tienen nada fuera del montículo, así que
+// el recolector los libera por completo.
 //
 // `env_size` es el número de locales del entorno. `PDCRT_NUM_LOCALES_ESP` será
 // agregado automáticamente.
 pdcrt_error pdcrt_aloj_env(PDCRT_OUT pdcrt_env** env, pdcrt_gc* gc, size_t env_size);
-void pdcrt_dealoj_env(pdcrt_env* env, pdcrt_alojador alojador);
 
 // Devuelve un C-string que es una versión legible del tipo del objeto
 // especificado. Tal como con `pdcrt_perror`, el puntero devuelto tiene
@@ -1070,12 +1506,51 @@ void pdcrt_insertar_elemento_en_pila(pdcrt_pila* pila, pdcrt_alojador alojador,
 // texto ya existente en vez de crear uno nuevo. Esto significa que nunca
 // habrán dos textos con el mismo contenido, lo que significa que podemos
 // comparar textos simplemente comparando sus punteros.
+//
+// La lista no mantiene vivos a sus textos: en cada recolección de basura se
+// quitan de la lista los textos que no sean alcanzables desde otro lugar. Los
+// textos de las constantes siempre son alcanzables.
+
+// Una ranura de la tabla de textos. Si `texto` es NULL la ranura está vacía
+// (si `hash` es 0) o borrada (si `hash` es `PDCRT_RANURA_DE_TEXTOS_BORRADA`).
+typedef struct pdcrt_ranura_de_textos
+{
+    // El hash del contenido del texto (ver `pdcrt_hash_de_texto`). Guardarlo
+    // evita tener que recalcularlo al mover el texto a otra tabla y permite
+    // descartar casi todas las ranuras sin comparar contenidos.
+    uint64_t hash;
+    PDCRT_NULL pdcrt_texto* texto;
+} pdcrt_ranura_de_textos;
+
+#define PDCRT_RANURA_DE_TEXTOS_BORRADA 1
+
+// Tabla hash con direccionamiento abierto (sondeo lineal). `capacidad` es
+// siempre una potencia de 2 y `ocupadas` cuenta tanto las ranuras con texto
+// como las borradas.
+typedef struct pdcrt_tabla_de_textos
+{
+    size_t capacidad, ocupadas;
+    PDCRT_NULL PDCRT_ARR(capacidad) pdcrt_ranura_de_textos* ranuras;
+} pdcrt_tabla_de_textos;
 
 typedef struct pdcrt_textos
 {
-    // Arreglo ordenado de textos.
-    size_t capacidad, longitud;
-    PDCRT_ARR(capacidad) pdcrt_texto** textos;
+    // La tabla en la que se insertan los textos nuevos.
+    pdcrt_tabla_de_textos actual;
+    // Cuando `actual` se llena se reemplaza por una tabla más grande, pero
+    // los textos de la tabla vieja no se mueven todos a la vez: cada inserción
+    // mueve unas pocas ranuras (desde `migradas`) y mientras tanto las
+    // búsquedas revisan ambas tablas. Así ninguna inserción tiene que mover
+    // la tabla completa.
+    pdcrt_tabla_de_textos anterior;
+    size_t migradas;
+    // El número de textos en ambas tablas.
+    size_t longitud;
+    // Los textos insertados desde la última recolección. Como tras cada
+    // recolección todos los textos sobrevivientes son viejos, una recolección
+    // joven solo tiene que revisar estos en vez de la tabla completa.
+    PDCRT_NULL PDCRT_ARR(capacidad_nuevos) pdcrt_texto** nuevos;
+    size_t num_nuevos, capacidad_nuevos;
 } pdcrt_textos;
 
 pdcrt_error pdcrt_inic_textos(pdcrt_gc* gc, size_t cap, PDCRT_OUT pdcrt_textos* textos);
@@ -1259,6 +1734,18 @@ pdcrt_error pdcrt_agregar_modulo(pdcrt_registro_de_modulos* registro, size_t i,
 bool pdcrt_obtener_modulo(pdcrt_registro_de_modulos* registro, pdcrt_texto* nombre, PDCRT_OUT pdcrt_modulo** modulo);
 
 
+// Región contigua de la que se alojan las locales de los marcos.
+//
+// Los marcos se crean y destruyen en orden LIFO, así que sus locales se
+// alojan incrementando `tope` y se liberan decrementándolo. Si la región se
+// llena, los marcos alojan sus locales con el alojador del contexto.
+typedef struct pdcrt_pila_de_locales
+{
+    PDCRT_ARR(capacidad) pdcrt_objeto* elementos;
+    size_t tope;
+    size_t capacidad;
+} pdcrt_pila_de_locales;
+
 // El contexto del intérprete.
 //
 // El núcleo del runtime. El contexto contiene todas las partes "globales" del
@@ -1273,6 +1760,7 @@ bool pdcrt_obtener_modulo(pdcrt_registro_de_modulos* registro, pdcrt_texto* nomb
 typedef struct pdcrt_contexto
 {
     pdcrt_pila pila;
+    pdcrt_pila_de_locales locales;
     pdcrt_alojador alojador;
     pdcrt_gc gc;
     pdcrt_constantes constantes;
@@ -1282,7 +1770,9 @@ typedef struct pdcrt_contexto
     char** argv;
     pdcrt_objeto claseObjeto;
     pdcrt_objeto entornoBootstrap;
-    unsigned int generacionDelRecolector;
+    // El número máximo de elementos en la pila de continuaciones. Ver
+    // `PDCRT_OPT_LIMITE_DE_RECURSION`.
+    size_t limite_de_recursion;
 } pdcrt_contexto;
 
 // Variantes de las funciones con el mismo nombre pero sin el `_simple` al
@@ -1338,6 +1828,8 @@ typedef struct pdcrt_marco
     pdcrt_contexto* contexto;
     PDCRT_ARR(num_locales) pdcrt_objeto* locales;
     size_t num_locales;
+    // Si `locales` fue alojado en la `pdcrt_pila_de_locales` del contexto.
+    bool locales_en_la_pila;
     PDCRT_NULL struct pdcrt_marco* marco_anterior;
     // El número de valores que este marco debe devolver.
     //
@@ -1350,6 +1842,10 @@ typedef struct pdcrt_marco
     // inicializado al valor del parámetro `rets`.
     int num_valores_a_devolver;
     PDCRT_NULL const char* nombre;
+    // La última recolección de basura que marcó las locales de este marco (ver
+    // `pdcrt_gc.ciclo`). Si es la recolección actual, este marco y todos sus
+    // marcos anteriores ya fueron recorridos.
+    size_t ciclo_gc;
 } pdcrt_marco;
 
 // Inicializa y desinicializa un marco. `num_locales` es el número de locales,
@@ -1359,8 +1855,45 @@ typedef struct pdcrt_marco
 // `marco_anterior` es el marco que activo a este o `NULL` si ningún marco
 // activó a este.
 pdcrt_error pdcrt_inic_marco(pdcrt_marco* marco, pdcrt_contexto* contexto, size_t num_locales, PDCRT_NULL pdcrt_marco* marco_anterior, int num_valores_a_devolver);
+// Inicializa el marco de una función nativa (un receptor o builtin escrito en
+// C). Estos marcos no tienen locales (ni siquiera las especiales), así que no
+// alojan nada y nunca fallan. Se desinicializan con `pdcrt_deinic_marco` como
+// cualquier otro marco.
+void pdcrt_inic_marco_nativo(pdcrt_marco* marco, pdcrt_contexto* contexto, PDCRT_NULL pdcrt_marco* marco_anterior, int num_valores_a_devolver);
 void pdcrt_deinic_marco(pdcrt_marco* marco);
 
+// La pila de continuaciones del trampolín.
+//
+// Cada elemento de la pila es una continuación junto con el marco en el que se
+// ejecuta. Los elementos se guardan en segmentos de tamaño fijo enlazados
+// entre sí: los marcos nunca se mueven de lugar (otros marcos y continuaciones
+// tienen punteros a ellos) y las llamadas poco profundas se mantienen en
+// memoria contigua. Al sacar todos los elementos de un segmento este no se
+// libera inmediatamente, sino que se guarda en `siguiente` para reusarlo.
+//
+// El marco del primer elemento (el marco `marco_base` pasado a
+// `pdcrt_trampolin`) no se guarda en la pila.
+#define PDCRT_TAM_SEGMENTO_DE_CONTINUACIONES 256
+
+typedef struct pdcrt_segmento_de_continuaciones
+{
+    PDCRT_NULL struct pdcrt_segmento_de_continuaciones* anterior;
+    PDCRT_NULL struct pdcrt_segmento_de_continuaciones* siguiente;
+    pdcrt_continuacion continuaciones[PDCRT_TAM_SEGMENTO_DE_CONTINUACIONES];
+    pdcrt_marco marcos[PDCRT_TAM_SEGMENTO_DE_CONTINUACIONES];
+} pdcrt_segmento_de_continuaciones;
+
+typedef struct pdcrt_pila_de_continuaciones
+{
+    pdcrt_segmento_de_continuaciones* primero;
+    pdcrt_segmento_de_continuaciones* actual;
+    // Número de elementos en el segmento `actual`.
+    size_t num_en_actual;
+    // Número total de elementos.
+    size_t num_elementos;
+    pdcrt_marco* marco_base;
+} pdcrt_pila_de_continuaciones;
+
 // Fija el valor de una variable local.
 void pdcrt_fijar_local(pdcrt_marco* marco, pdcrt_local_index n, pdcrt_objeto obj);
 // Obtiene el valor de una variable local.
@@ -1478,6 +2011,33 @@ void pdcrt_marco_fijar_nombre(pdcrt_marco* marco, const char* nombre);
 #define PDCRT_CONT(name, k)                                             \
     PDCRT_PROC_V_PRIVATE                                                \
     pdcrt_continuacion PDCRT_CONT_NAME(name, k)(pdcrt_marco* name##marco_actual) // {}
+
+// El cuerpo de un procedimiento.
+//
+// Todas las partes (el código entre dos continuaciones) de un procedimiento
+// se emiten en una sola función de C: el "cuerpo". Cada parte empieza con una
+// etiqueta (`PDCRT_LABEL`) y el control de flujo dentro del procedimiento
+// (`NAME`, `JMP` y `CHOOSE`) se compila a `goto`s entre ellas, así que solo
+// los envíos de mensajes y las llamadas vuelven al trampolín.
+//
+// El procedimiento y cada una de sus continuaciones son funciones pequeñas
+// que entran al cuerpo (con `PDCRT_ENTER_BODY`) en la parte `k`.
+#define PDCRT_BODY_NAME(name)                   \
+    PDCRT_MANGLING_PREFIX##pdprocb_##name
+#define PDCRT_LABEL_NAME(name, k)               \
+    pdlabel_##name##_##k
+
+#define PDCRT_BODY(name)                                                \
+    PDCRT_PROC_V_PRIVATE                                                \
+    pdcrt_continuacion PDCRT_BODY_NAME(name)(pdcrt_marco* marco, int pdcrt_k) // {}
+#define PDCRT_BODY_PRELUDE(name)                \
+    switch(pdcrt_k)
+#define PDCRT_BODY_ENTRY(name, k, n)            \
+    case n: goto PDCRT_LABEL_NAME(name, k)
+#define PDCRT_ENTER_BODY(name, n)               \
+    return PDCRT_BODY_NAME(name)(marco, n)
+#define PDCRT_LABEL(name, k)                    \
+    PDCRT_LABEL_NAME(name, k):
 #define PDCRT_PROC_PRELUDE(name, nparams, nlocals, isvariadic)          \
     pdcrt_error pderrno;                                                \
     pdcrt_contexto* ctx = name##marco_anterior->contexto;               \
@@ -1494,7 +2054,7 @@ void pdcrt_marco_fijar_nombre(pdcrt_marco* marco, const char* nombre);
     }                                                                   \
     while(0)
 #define PDCRT_PARAM(idx, param)                                     \
-    pdcrt_fijar_local(marco, idx, pdcrt_sacar_de_pila(&ctx->pila))
+    pdcrt_fijar_local(marco, idx, pdcrt_sacar_de_pila(&marco->contexto->pila))
 #define PDCRT_PROC_METHOD()
 #define PDCRT_PROC_VARIADIC(name, nparams, localid)                     \
     do                                                                  \
@@ -1517,6 +2077,8 @@ void pdcrt_marco_fijar_nombre(pdcrt_marco* marco, const char* nombre);
     PDCRT_PROC(name, visibility);
 #define PDCRT_DECLARE_CONT(name, k)             \
     PDCRT_CONT(name, k);
+#define PDCRT_DECLARE_BODY(name)                \
+    PDCRT_BODY(name);
 
 // Declara el nombre externo de una función
 #define PDCRT_DECLARE_CNAME(procname, extname)                          \
@@ -1554,6 +2116,38 @@ void pdcrt_marco_fijar_nombre(pdcrt_marco* marco, const char* nombre);
     }                                                                   \
     while(0)
 
+// Salta a la parte `k` del cuerpo actual. `PDCRT_JUMP` solo debe usarse para
+// saltar hacia adelante: los saltos hacia atrás (los bucles) usan
+// `PDCRT_LOOP`, que vuelve al trampolín si el recolector de basura tiene que
+// ejecutarse.
+#define PDCRT_JUMP(name, k)                     \
+    goto PDCRT_LABEL_NAME(name, k)
+
+#define PDCRT_LOOP(name, k)                                             \
+    do                                                                  \
+    {                                                                   \
+        if(pdcrt_deberia_recolectar_basura(&marco->contexto->gc))       \
+            PDCRT_CONTINUE(name, k);                                    \
+        goto PDCRT_LABEL_NAME(name, k);                                 \
+    }                                                                   \
+    while(0)
+
+// Ejecuta la operación `op` (que devuelve una continuación). Si esta solo
+// continúa en la parte `k` del procedimiento `name` (por ejemplo, cuando
+// `pdcrt_op_sum` suma dos números sin enviar un mensaje) salta directamente a
+// esa parte en vez de volver al trampolín.
+#define PDCRT_FUSE(name, k, op)                                         \
+    do                                                                  \
+    {                                                                   \
+        pdcrt_continuacion pdcrt_sk = (op);                             \
+        if(pdcrt_sk.tipo == PDCRT_CONT_CONTINUAR                        \
+           && pdcrt_sk.valor.continuar.proc == (pdcrt_funcion_generica) &PDCRT_CONT_NAME(name, k) \
+           && pdcrt_sk.valor.continuar.marco_actual == marco)           \
+            goto PDCRT_LABEL_NAME(name, k);                             \
+        return pdcrt_sk;                                                \
+    }                                                                   \
+    while(0)
+
 
 // Los opcodes.
 //
@@ -1617,12 +2211,25 @@ void pdcrt_op_nl(pdcrt_marco* marco);
 
 pdcrt_continuacion pdcrt_op_msg(pdcrt_marco* marco, pdcrt_proc_continuacion proc, int cid, int args, int rets);
 pdcrt_continuacion pdcrt_op_tail_msg(pdcrt_marco* marco, int cid, int args, int rets);
+// Las variantes `_cache` son como las normales, pero usan la caché del sitio
+// de envío `cache`.
+pdcrt_continuacion pdcrt_op_msg_cache(pdcrt_marco* marco, pdcrt_proc_continuacion proc, pdcrt_cache_de_mensaje* cache, int cid, int args, int rets);
+pdcrt_continuacion pdcrt_op_tail_msg_cache(pdcrt_marco* marco, pdcrt_cache_de_mensaje* cache, int cid, int args, int rets);
 pdcrt_continuacion pdcrt_op_msgv(pdcrt_marco* marco, pdcrt_proc_continuacion proc, int cid, const unsigned char* proto, int args, int rets);
 pdcrt_continuacion pdcrt_op_tail_msgv(pdcrt_marco* marco, int cid, const unsigned char* proto, int args, int rets);
 pdcrt_continuacion pdcrt_op_dynmsg(pdcrt_marco* marco, pdcrt_proc_continuacion proc, int args, int rets);
 pdcrt_continuacion pdcrt_op_tail_dynmsg(pdcrt_marco* marco, int args, int rets);
+pdcrt_continuacion pdcrt_op_dynmsg_cache(pdcrt_marco* marco, pdcrt_proc_continuacion proc, pdcrt_cache_de_mensaje* cache, int args, int rets);
+pdcrt_continuacion pdcrt_op_tail_dynmsg_cache(pdcrt_marco* marco, pdcrt_cache_de_mensaje* cache, int args, int rets);
 pdcrt_continuacion pdcrt_op_dynmsgv(pdcrt_marco* marco, pdcrt_proc_continuacion proc, const unsigned char* proto, int args, int rets);
 pdcrt_continuacion pdcrt_op_tail_dynmsgv(pdcrt_marco* marco, const unsigned char* proto, int args, int rets);
+// Si el envío "tail" en la cima de la pila es `llamar` a una closure del
+// procedimiento `proc` (el procedimiento de `marco`), reinicia `marco` con los
+// nuevos argumentos en `ESUP` y la pila, y devuelve true. El código compilado
+// solo tiene que sacar los parámetros y saltar al principio del procedimiento
+// en vez de volver al trampolín. Si no, no hace nada y devuelve false.
+bool pdcrt_op_tail_msg_propio(pdcrt_marco* marco, pdcrt_proc_t proc, int cid, int args, int rets, int nparams);
+bool pdcrt_op_tail_dynmsg_propio(pdcrt_marco* marco, pdcrt_proc_t proc, int args, int rets, int nparams);
 
 void pdcrt_op_spush(pdcrt_marco* marco, pdcrt_local_index eact, pdcrt_local_index esup);
 void pdcrt_op_spop(pdcrt_marco* marco, pdcrt_local_index eact, pdcrt_local_index esup);